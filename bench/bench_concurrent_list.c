@@ -0,0 +1,149 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../concurrent_list.h"
+#include "../linked_list.h"
+
+/*
+ * Scaling of the lock-free list against linked_list behind one
+ * global mutex, with 80% searches, 10% insertions and 10%
+ * removals over a fixed key range.
+ *
+ *	./bench/cl_bench [key range] [operations per thread]
+ */
+
+static uintptr_t key_range = 1000;
+static long ops_per_thread = 200000;
+
+static int
+uintptr_key_match(void *key1, void *key2, void *metadata){
+    uintptr_t k1 = (uintptr_t) key1,
+	k2 = (uintptr_t) key2;
+
+    if (k1 < k2)
+	return -1;
+    else if (k1 == k2)
+	return 0;
+    else
+	return 1;
+}
+
+typedef struct bench_arg {
+    concurrent_list *cl;
+    linked_list *ll;
+    pthread_mutex_t *lock;
+    unsigned int seed;
+} bench_arg;
+
+static void *
+cl_worker(void *p){
+    bench_arg *arg = (bench_arg *) p;
+    uintptr_t key;
+    long i;
+    int op;
+
+    for (i = 0; i < ops_per_thread; i++){
+	key = rand_r(&arg->seed) % key_range + 1;
+	op = rand_r(&arg->seed) % 10;
+	if (op == 0)
+	    cl_insert(arg->cl, (void *) key);
+	else if (op == 1)
+	    cl_remove_by_key(arg->cl, (void *) key);
+	else
+	    cl_search_by_key(arg->cl, (void *) key);
+    }
+
+    return NULL;
+}
+
+static void *
+ll_worker(void *p){
+    bench_arg *arg = (bench_arg *) p;
+    uintptr_t key;
+    long i;
+    int op;
+
+    for (i = 0; i < ops_per_thread; i++){
+	key = rand_r(&arg->seed) % key_range + 1;
+	op = rand_r(&arg->seed) % 10;
+	pthread_mutex_lock(arg->lock);
+	if (op == 0){
+	    if (!ll_has_key(arg->ll, (void *) key))
+		ll_asc_insert(arg->ll, (void *) key);
+	}else if (op == 1){
+	    ll_remove_by_key(arg->ll, (void *) key);
+	}else{
+	    ll_search_by_key(arg->ll, (void *) key);
+	}
+	pthread_mutex_unlock(arg->lock);
+    }
+
+    return NULL;
+}
+
+static double
+now(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Return million operations per second */
+static double
+run(int nthreads, bool lock_free){
+    pthread_t threads[64];
+    bench_arg args[64];
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    concurrent_list *cl = cl_init(NULL, uintptr_key_match, NULL, NULL);
+    linked_list *ll = ll_init(NULL, uintptr_key_match, NULL, NULL);
+    uintptr_t key;
+    double start, elapsed;
+    int t;
+
+    /* Start half full */
+    for (key = 2; key <= key_range; key += 2){
+	cl_insert(cl, (void *) key);
+	ll_tail_insert(ll, (void *) key);
+    }
+
+    start = now();
+    for (t = 0; t < nthreads; t++){
+	args[t].cl = cl;
+	args[t].ll = ll;
+	args[t].lock = &lock;
+	args[t].seed = t + 1;
+	pthread_create(&threads[t], NULL, lock_free ? cl_worker : ll_worker,
+		       &args[t]);
+    }
+    for (t = 0; t < nthreads; t++)
+	pthread_join(threads[t], NULL);
+    elapsed = now() - start;
+
+    cl_destroy(cl);
+    ll_destroy(ll);
+
+    return nthreads * ops_per_thread / elapsed / 1e6;
+}
+
+int
+main(int argc, char **argv){
+    int threads[] = { 1, 2, 4, 8, 16 }, i;
+
+    if (argc > 1)
+	key_range = strtoul(argv[1], NULL, 10);
+    if (argc > 2)
+	ops_per_thread = strtol(argv[2], NULL, 10);
+
+    printf("key range %lu, %ld operations per thread\n",
+	   (unsigned long) key_range, ops_per_thread);
+    printf("%8s %16s %16s\n", "threads", "lock-free Mops", "mutex Mops");
+    for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++)
+	printf("%8d %16.3f %16.3f\n", threads[i],
+	       run(threads[i], true), run(threads[i], false));
+
+    return 0;
+}
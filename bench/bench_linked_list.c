@@ -0,0 +1,617 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../linked_list.h"
+
+/*
+ * Cost of the public functions of linked_list, in nanoseconds and
+ * allocations per operation, printed as one JSON document.
+ *
+ *	./bench/ll_bench [max size] > result.json
+ *
+ * The parallel functions run with BENCH_THREADS threads, and
+ * ll_asc_insert_batch() takes up to BENCH_BATCH items per call.
+ *
+ * Every combination of list size (10 to 'max size', 10M by
+ * default), key distribution and ll_attr setting gets one list.
+ * The list is built by ll_tail_insert() in the order of the
+ * distribution and then sorted, so that the nodes are visited in
+ * the allocation order ("sequential"), in the reverse order
+ * ("reverse") or in a random order ("random").
+ *
+ * The data is the key itself. The keys are the even numbers from
+ * 2 to 2 * size, so that odd keys are misses. Each operation is
+ * repeated until BENCH_MIN_TIME passes or BENCH_MAX_OPS operations
+ * are done. Operations that modify the list are undone afterward
+ * outside of the measurement, and BENCH_MAX_TIME bounds the whole
+ * loop including the undo.
+ *
+ * Then, the scans over records reached through key_access_cb are
+ * measured for each prefetch distance ("random_records"). Both the
+ * nodes and the records are in random order in memory, so the
+ * effect of prefetching shows once the list is much larger than
+ * the last level cache.
+ *
+ * The program is linked with -Wl,--wrap=malloc (and calloc,
+ * realloc) to count the allocations of the library.
+ */
+
+#define BENCH_MIN_TIME 0.05
+#define BENCH_MAX_OPS 100000
+#define BENCH_MAX_TIME 1.0
+
+/* Items per ll_asc_insert_batch() call, at most */
+#define BENCH_BATCH 1000
+
+/* Threads of the parallel functions */
+#define BENCH_THREADS 4
+
+static uintptr_t max_size = 10000000;
+
+/* Allocation counter, incremented by the wrappers below */
+static unsigned long allocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *
+__wrap_malloc(size_t size){
+    allocations++;
+
+    return __real_malloc(size);
+}
+
+void *
+__wrap_calloc(size_t nmemb, size_t size){
+    allocations++;
+
+    return __real_calloc(nmemb, size);
+}
+
+void *
+__wrap_realloc(void *ptr, size_t size){
+    allocations++;
+
+    return __real_realloc(ptr, size);
+}
+
+static int
+uintptr_key_match(void *key1, void *key2, void *metadata){
+    uintptr_t k1 = (uintptr_t) key1,
+	k2 = (uintptr_t) key2;
+
+    if (k1 < k2)
+	return -1;
+    else if (k1 == k2)
+	return 0;
+    else
+	return 1;
+}
+
+static uint64_t
+uintptr_key_hash(void *key, void *metadata){
+    return (uintptr_t) key;
+}
+
+static bool
+never_match(void *data, void *ctx){
+    return false;
+}
+
+static bool
+always_match(void *data, void *ctx){
+    return true;
+}
+
+/* The inserted keys are odd, while the original ones are even */
+static bool
+odd_key(void *data, void *ctx){
+    return (uintptr_t) data % 2 == 1;
+}
+
+static void
+visit_nothing(void *data, void *arg){}
+
+typedef struct bench_attr {
+    const char *name;
+    ll_attr attr;
+} bench_attr;
+
+static const bench_attr bench_attrs[] = {
+    { "default", { 0 } },
+    { "pooled", { .nodes_per_slab = 4096 } },
+    { "indexed", { .nodes_per_slab = 4096, .doubly_linked = true,
+		   .skip_index = true, .key_hash_cb = uintptr_key_hash } },
+};
+
+static const char *distributions[] = { "sequential", "reverse", "random" };
+
+/* xorshift64, enough for picking keys and positions */
+static uint64_t rng_state = 88172645463325252ULL;
+
+static uintptr_t
+rng(uintptr_t range){
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+
+    return rng_state % range;
+}
+
+static double
+now(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Measurement of one operation */
+typedef struct bench_timer {
+    double begin, start, elapsed;
+    unsigned long start_allocations, allocations;
+    long ops;
+} bench_timer;
+
+static void
+timer_start(bench_timer *t){
+    t->start_allocations = allocations;
+    t->start = now();
+}
+
+/* Add the time and the allocations since timer_start() */
+static void
+timer_stop(bench_timer *t, long ops){
+    t->elapsed += now() - t->start;
+    t->allocations += allocations - t->start_allocations;
+    t->ops += ops;
+}
+
+/* Keep measuring while this returns true. At least once */
+static bool
+timer_continue(bench_timer *t){
+    if (t->ops == 0){
+	t->begin = now();
+	return true;
+    }
+
+    return t->ops < BENCH_MAX_OPS && t->elapsed < BENCH_MIN_TIME &&
+	now() - t->begin < BENCH_MAX_TIME;
+}
+
+static bool first_result = true;
+
+static void
+report(const char *op, uintptr_t size, const char *dist,
+       const char *attr, bench_timer *t){
+    printf("%s\n    {\"op\": \"%s\", \"size\": %lu, \"distribution\": \"%s\", "
+	   "\"attr\": \"%s\", \"ops\": %ld, \"ns_per_op\": %.2f, "
+	   "\"allocs_per_op\": %.3f}",
+	   first_result ? "" : ",", op, (unsigned long) size, dist, attr,
+	   t->ops, t->elapsed * 1e9 / t->ops,
+	   (double) t->allocations / t->ops);
+    first_result = false;
+    fflush(stdout);
+}
+
+/* Measure 'body' repeatedly as one operation at a time */
+#define BENCH_LOOP(op, body)							\
+    do {								\
+	bench_timer t = { 0 };						\
+	while(timer_continue(&t)){					\
+	    timer_start(&t);						\
+	    body;							\
+	    timer_stop(&t, 1);						\
+	}								\
+	report(op, size, dist, ba->name, &t);				\
+    } while(0)
+
+/* Keys in the insertion order of the distribution */
+static uintptr_t *
+gen_keys(uintptr_t size, int dist){
+    uintptr_t *keys, i, j, tmp;
+
+    if ((keys = (uintptr_t *) malloc(sizeof(uintptr_t) * size)) == NULL){
+	perror("malloc");
+	exit(-1);
+    }
+
+    for (i = 0; i < size; i++)
+	keys[i] = dist == 1 ? 2 * (size - i) : 2 * (i + 1);
+
+    if (dist == 2){
+	for (i = size - 1; i > 0; i--){
+	    j = rng(i + 1);
+	    tmp = keys[i];
+	    keys[i] = keys[j];
+	    keys[j] = tmp;
+	}
+    }
+
+    return keys;
+}
+
+static size_t
+encode_key(void *data, void *buf, size_t size, void *arg){
+    if (size >= sizeof(uintptr_t))
+	memcpy(buf, &data, sizeof(uintptr_t));
+
+    return sizeof(uintptr_t);
+}
+
+static void *
+decode_key(const void *buf, size_t len, void *arg){
+    uintptr_t key;
+
+    memcpy(&key, buf, sizeof(uintptr_t));
+
+    return (void *) key;
+}
+
+/* Descriptor of an unlinked temporary file */
+static int
+temp_fd(void){
+    FILE *fp;
+    int fd;
+
+    if ((fp = tmpfile()) == NULL){
+	perror("tmpfile");
+	exit(-1);
+    }
+    fd = dup(fileno(fp));
+    fclose(fp);
+
+    return fd;
+}
+
+static linked_list *
+new_list(const bench_attr *ba){
+    return ll_init_with_attr(NULL, uintptr_key_match, NULL, NULL, &ba->attr);
+}
+
+static void
+bench_list(uintptr_t size, int dist_index, const bench_attr *ba){
+    const char *dist = distributions[dist_index];
+    uintptr_t *keys = gen_keys(size, dist_index), i, key, batch;
+    void *items[BENCH_BATCH];
+    linked_list *ll, *first, *merged;
+    bench_timer t;
+    ll_iter iter;
+    void *data;
+    int pos, fd;
+
+    /* Bulk operations, reported per node */
+    ll = new_list(ba);
+    memset(&t, 0, sizeof(t));
+    timer_start(&t);
+    for (i = size; i > 0; i--)
+	ll_insert(ll, (void *) keys[i - 1]);
+    timer_stop(&t, size);
+    report("insert", size, dist, ba->name, &t);
+
+    memset(&t, 0, sizeof(t));
+    timer_start(&t);
+    ll_remove_all(ll);
+    timer_stop(&t, size);
+    report("remove_all", size, dist, ba->name, &t);
+
+    memset(&t, 0, sizeof(t));
+    timer_start(&t);
+    for (i = 0; i < size; i++)
+	ll_tail_insert(ll, (void *) keys[i]);
+    timer_stop(&t, size);
+    report("tail_insert", size, dist, ba->name, &t);
+
+    memset(&t, 0, sizeof(t));
+    timer_start(&t);
+    ll_sort(ll);
+    timer_stop(&t, size);
+    report("sort", size, dist, ba->name, &t);
+
+    /* Same order as sorted above, with several threads */
+    first = new_list(ba);
+    for (i = 0; i < size; i++)
+	ll_tail_insert(first, (void *) keys[i]);
+    memset(&t, 0, sizeof(t));
+    timer_start(&t);
+    ll_parallel_sort(first, BENCH_THREADS);
+    timer_stop(&t, size);
+    report("parallel_sort", size, dist, ba->name, &t);
+    ll_destroy(first);
+
+    memset(&t, 0, sizeof(t));
+    timer_start(&t);
+    ll_iter_begin(ll, &iter);
+    while(ll_iter_next(&iter, &data))
+	;
+    ll_iter_end(&iter);
+    timer_stop(&t, size);
+    report("iter", size, dist, ba->name, &t);
+
+    memset(&t, 0, sizeof(t));
+    timer_start(&t);
+    ll_begin_iter(ll);
+    while(ll_get_iter_data(ll) != NULL)
+	;
+    ll_end_iter(ll);
+    timer_stop(&t, size);
+    report("begin_iter", size, dist, ba->name, &t);
+
+    memset(&t, 0, sizeof(t));
+    timer_start(&t);
+    ll_remove_if(ll, never_match, NULL, NULL);
+    timer_stop(&t, size);
+    report("remove_if", size, dist, ba->name, &t);
+
+    memset(&t, 0, sizeof(t));
+    timer_start(&t);
+    ll_retain_if(ll, always_match, NULL, NULL);
+    timer_stop(&t, size);
+    report("retain_if", size, dist, ba->name, &t);
+
+    memset(&t, 0, sizeof(t));
+    timer_start(&t);
+    ll_parallel_for_each(ll, visit_nothing, NULL, BENCH_THREADS);
+    timer_stop(&t, size);
+    report("parallel_for_each", size, dist, ba->name, &t);
+
+    /* Single operations on the sorted list */
+    BENCH_LOOP("search_hit",
+	       ll_search_by_key(ll, (void *) (2 * (rng(size) + 1))));
+    BENCH_LOOP("search_miss",
+	       ll_search_by_key(ll, (void *) (2 * rng(size + 1) + 1)));
+    BENCH_LOOP("has_key", ll_has_key(ll, (void *) (2 * (rng(size) + 1))));
+    BENCH_LOOP("rank", ll_rank(ll, (void *) (2 * rng(size + 1) + 1)));
+    BENCH_LOOP("ref_index_data", ll_ref_index_data(ll, rng(size)));
+    BENCH_LOOP("parallel_search",
+	       ll_parallel_search(ll, (void *) (2 * rng(size + 1) + 1),
+				  BENCH_THREADS));
+
+    /* The data is the key, so the replacement keeps the order */
+    BENCH_LOOP("replace_by_key",
+	       key = 2 * (rng(size) + 1);
+	       ll_replace_by_key(ll, (void *) key, (void *) key));
+
+    /*
+     * Each modification is undone by the opposite one, which is
+     * not measured. Removals take existing data, so that the undo
+     * doesn't leave the removed node in the finger.
+     */
+    memset(&t, 0, sizeof(t));
+    while(timer_continue(&t)){
+	key = 2 * rng(size + 1) + 1;
+	timer_start(&t);
+	ll_asc_insert(ll, (void *) key);
+	timer_stop(&t, 1);
+	ll_remove_by_key(ll, (void *) key);
+    }
+    report("asc_insert", size, dist, ba->name, &t);
+
+    /* Reported per item. The odd keys are removed in one pass */
+    batch = size < BENCH_BATCH ? size : BENCH_BATCH;
+    memset(&t, 0, sizeof(t));
+    while(timer_continue(&t)){
+	for (i = 0; i < batch; i++)
+	    items[i] = (void *) (2 * rng(size + 1) + 1);
+	timer_start(&t);
+	ll_asc_insert_batch(ll, items, batch, NULL);
+	timer_stop(&t, batch);
+	ll_remove_if(ll, odd_key, NULL, NULL);
+    }
+    report("asc_insert_batch", size, dist, ba->name, &t);
+
+    memset(&t, 0, sizeof(t));
+    while(timer_continue(&t)){
+	key = 2 * (rng(size) + 1);
+	timer_start(&t);
+	ll_remove_by_key(ll, (void *) key);
+	timer_stop(&t, 1);
+	ll_asc_insert(ll, (void *) key);
+    }
+    report("remove_by_key", size, dist, ba->name, &t);
+
+    /* 2 * pos + 1 keeps the list in ascending order */
+    memset(&t, 0, sizeof(t));
+    while(timer_continue(&t)){
+	pos = rng(size + 1);
+	timer_start(&t);
+	ll_index_insert(ll, (void *) (2 * (uintptr_t) pos + 1), pos);
+	timer_stop(&t, 1);
+	ll_index_remove(ll, pos);
+    }
+    report("index_insert", size, dist, ba->name, &t);
+
+    memset(&t, 0, sizeof(t));
+    while(timer_continue(&t)){
+	pos = rng(size);
+	timer_start(&t);
+	data = ll_index_remove(ll, pos);
+	timer_stop(&t, 1);
+	ll_index_insert(ll, data, pos);
+    }
+    report("index_remove", size, dist, ba->name, &t);
+
+    memset(&t, 0, sizeof(t));
+    while(timer_continue(&t)){
+	timer_start(&t);
+	data = ll_remove_first_data(ll);
+	timer_stop(&t, 1);
+	ll_insert(ll, data);
+    }
+    report("remove_first_data", size, dist, ba->name, &t);
+
+    memset(&t, 0, sizeof(t));
+    while(timer_continue(&t)){
+	timer_start(&t);
+	data = ll_tail_remove(ll);
+	timer_stop(&t, 1);
+	ll_tail_insert(ll, data);
+    }
+    report("tail_remove", size, dist, ba->name, &t);
+
+    /* Split in half and merge back. Both are timed separately */
+    if (size > 1){
+	bench_timer split_t = { 0 }, merge_t = { 0 };
+
+	while(timer_continue(&split_t)){
+	    timer_start(&split_t);
+	    first = ll_split(ll, size / 2);
+	    timer_stop(&split_t, 1);
+
+	    timer_start(&merge_t);
+	    merged = ll_merge(first, ll);
+	    timer_stop(&merge_t, 1);
+
+	    ll_destroy(first);
+	    ll_destroy(ll);
+	    ll = merged;
+	}
+	report("split", size, dist, ba->name, &split_t);
+	report("merge", size, dist, ba->name, &merge_t);
+    }
+
+    /* Save to a temporary file and load it back, reported per node */
+    fd = temp_fd();
+    memset(&t, 0, sizeof(t));
+    timer_start(&t);
+    if (ll_serialize(ll, fd, encode_key, NULL) != 0)
+	exit(-1);
+    timer_stop(&t, size);
+    report("serialize", size, dist, ba->name, &t);
+
+    lseek(fd, 0, SEEK_SET);
+    first = new_list(ba);
+    memset(&t, 0, sizeof(t));
+    timer_start(&t);
+    if (ll_deserialize(fd, decode_key, NULL, first) != 0)
+	exit(-1);
+    timer_stop(&t, size);
+    report("deserialize", size, dist, ba->name, &t);
+    ll_destroy(first);
+    close(fd);
+
+    memset(&t, 0, sizeof(t));
+    timer_start(&t);
+    ll_destroy(ll);
+    timer_stop(&t, size);
+    report("destroy", size, dist, ba->name, &t);
+
+    free(keys);
+}
+
+/* Record of one cache line, with the key at the beginning */
+typedef struct bench_record {
+    uintptr_t key;
+    char payload[56];
+} bench_record;
+
+static void *
+record_key_access(void *data){
+    return (void *) ((bench_record *) data)->key;
+}
+
+static const unsigned int prefetch_distances[] = { 0, 1, 2, 4, 8 };
+
+static void
+bench_prefetch(uintptr_t size, bench_record *records, uintptr_t *keys,
+	       unsigned int distance){
+    const char *dist = "random_records";
+    char name[32];
+    bench_attr prefetch_attr = { name, { .prefetch_distance = distance } };
+    const bench_attr *ba = &prefetch_attr;
+    linked_list *ll;
+    bench_timer t;
+    ll_iter iter;
+    void *data;
+    uintptr_t i, key, sum = 0;
+
+    snprintf(name, sizeof(name), "prefetch=%u", distance);
+
+    /* Records in random order, then the nodes in random order too */
+    ll = ll_init_with_attr(record_key_access, uintptr_key_match, NULL, NULL,
+			   &ba->attr);
+    for (i = 0; i < size; i++)
+	ll_tail_insert(ll, (void *) &records[keys[i] / 2 - 1]);
+    ll_sort(ll);
+
+    memset(&t, 0, sizeof(t));
+    timer_start(&t);
+    ll_iter_begin(ll, &iter);
+    while(ll_iter_next(&iter, &data))
+	sum += ((bench_record *) data)->key;
+    ll_iter_end(&iter);
+    timer_stop(&t, size);
+    report("iter", size, dist, ba->name, &t);
+    if (sum != size * (size + 1))
+	exit(-1);
+
+    BENCH_LOOP("search_miss",
+	       ll_search_by_key(ll, (void *) (2 * rng(size + 1) + 1)));
+    BENCH_LOOP("rank", ll_rank(ll, (void *) (2 * rng(size + 1) + 1)));
+
+    memset(&t, 0, sizeof(t));
+    while(timer_continue(&t)){
+	key = 2 * (rng(size) + 1);
+	timer_start(&t);
+	ll_remove_by_key(ll, (void *) key);
+	timer_stop(&t, 1);
+	ll_asc_insert(ll, (void *) &records[key / 2 - 1]);
+    }
+    report("remove_by_key", size, dist, ba->name, &t);
+
+    memset(&t, 0, sizeof(t));
+    while(timer_continue(&t)){
+	key = 2 * (rng(size) + 1);
+	data = ll_remove_by_key(ll, (void *) key);
+	timer_start(&t);
+	ll_asc_insert(ll, data);
+	timer_stop(&t, 1);
+    }
+    report("asc_insert", size, dist, ba->name, &t);
+
+    ll_destroy(ll);
+}
+
+int
+main(int argc, char **argv){
+    bench_record *records;
+    uintptr_t size, i, *keys;
+    int d, a;
+
+    if (argc > 1)
+	max_size = strtoul(argv[1], NULL, 10);
+
+    printf("{\n  \"library\": \"linked_list\",\n  \"min_time\": %g,\n"
+	   "  \"max_ops\": %d,\n  \"results\": [",
+	   BENCH_MIN_TIME, BENCH_MAX_OPS);
+    for (size = 10; size <= max_size; size *= 10)
+	for (d = 0; d < sizeof(distributions) / sizeof(distributions[0]); d++)
+	    for (a = 0; a < sizeof(bench_attrs) / sizeof(bench_attrs[0]); a++)
+		bench_list(size, d, &bench_attrs[a]);
+
+    for (size = 10; size <= max_size; size *= 10){
+	if ((records = (bench_record *)
+	     malloc(sizeof(bench_record) * size)) == NULL){
+	    perror("malloc");
+	    exit(-1);
+	}
+	for (i = 0; i < size; i++)
+	    records[i].key = 2 * (i + 1);
+	keys = gen_keys(size, 2);
+
+	for (d = 0; d < sizeof(prefetch_distances) /
+		 sizeof(prefetch_distances[0]); d++)
+	    bench_prefetch(size, records, keys, prefetch_distances[d]);
+
+	free(keys);
+	free(records);
+    }
+    printf("\n  ]\n}\n");
+
+    return 0;
+}
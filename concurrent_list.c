@@ -0,0 +1,456 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "concurrent_list.h"
+
+/*
+ * Epoch-based reclamation.
+ *
+ * Every thread announces the global epoch while it runs an
+ * operation. A node unlinked from a list is tagged with the
+ * global epoch at that time and kept in a limbo list of the
+ * thread. The global epoch advances only when every running
+ * thread has announced the current one, so once the epoch
+ * moves two steps beyond the tag, no thread can hold the node.
+ *
+ * The reclamation domain is shared by all concurrent lists.
+ * Each thread gets a record at its first operation. Records
+ * are reused by later threads and never freed.
+ */
+typedef struct cl_thread_rec {
+    /* (Announced epoch << 1) | 1 while running, 0 otherwise */
+    _Atomic uint64_t state;
+    atomic_bool in_use;
+    struct cl_thread_rec *next;
+
+    /* Owned by the thread which uses the record */
+    unsigned int nesting;
+    uint64_t last_epoch;
+    cl_retired *limbo[3];
+    unsigned int retired_count;
+} cl_thread_rec;
+
+/* Try to advance the epoch at every this number of retired objects */
+#define CL_ADVANCE_INTERVAL 64
+
+static _Atomic(cl_thread_rec *) cl_registry;
+static _Atomic uint64_t cl_global_epoch = 1;
+static _Thread_local cl_thread_rec *cl_self;
+static pthread_key_t cl_exit_key;
+static pthread_once_t cl_exit_key_once = PTHREAD_ONCE_INIT;
+
+/* Give back the record of an exiting thread */
+static void
+cl_thread_exit(void *arg){
+    cl_thread_rec *rec = (cl_thread_rec *) arg;
+
+    atomic_store_explicit(&rec->state, 0, memory_order_release);
+    atomic_store_explicit(&rec->in_use, false, memory_order_release);
+}
+
+static void
+cl_create_exit_key(void){
+    if (pthread_key_create(&cl_exit_key, cl_thread_exit) != 0){
+	perror("pthread_key_create");
+	exit(-1);
+    }
+}
+
+static cl_thread_rec *
+cl_get_thread_rec(void){
+    cl_thread_rec *rec, *head;
+    bool expected;
+
+    if (cl_self != NULL)
+	return cl_self;
+
+    /* Reuse a record released by an exited thread */
+    for (rec = atomic_load(&cl_registry); rec != NULL; rec = rec->next){
+	expected = false;
+	if (!atomic_load(&rec->in_use) &&
+	    atomic_compare_exchange_strong(&rec->in_use, &expected, true))
+	    break;
+    }
+
+    if (rec == NULL){
+	if ((rec = (cl_thread_rec *) calloc(1, sizeof(cl_thread_rec))) == NULL){
+	    perror("calloc");
+	    exit(-1);
+	}
+	atomic_init(&rec->state, 0);
+	atomic_init(&rec->in_use, true);
+	head = atomic_load(&cl_registry);
+	do {
+	    rec->next = head;
+	} while(!atomic_compare_exchange_weak(&cl_registry, &head, rec));
+    }
+    rec->nesting = 0;
+
+    pthread_once(&cl_exit_key_once, cl_create_exit_key);
+    pthread_setspecific(cl_exit_key, rec);
+    cl_self = rec;
+
+    return rec;
+}
+
+static void
+cl_reclaim_list(cl_retired *r){
+    cl_retired *next;
+
+    for (; r != NULL; r = next){
+	next = r->next;
+	r->reclaim(r);
+    }
+}
+
+/* Advance the global epoch if every running thread has caught up */
+static void
+cl_try_advance(void){
+    cl_thread_rec *rec;
+    uint64_t epoch = atomic_load(&cl_global_epoch), state;
+
+    for (rec = atomic_load(&cl_registry); rec != NULL; rec = rec->next){
+	state = atomic_load(&rec->state);
+	if ((state & 1) && (state >> 1) != epoch)
+	    return;
+    }
+
+    atomic_compare_exchange_strong(&cl_global_epoch, &epoch, epoch + 1);
+}
+
+static cl_thread_rec *
+cl_enter(void){
+    cl_thread_rec *rec = cl_get_thread_rec();
+    uint64_t epoch, e;
+
+    if (rec->nesting++ > 0)
+	return rec;
+
+    epoch = atomic_load(&cl_global_epoch);
+    atomic_store(&rec->state, (epoch << 1) | 1);
+    /* Announce the epoch before reading any node */
+    atomic_thread_fence(memory_order_seq_cst);
+
+    /* Objects tagged two epochs before are unreachable now */
+    for (e = rec->last_epoch + 1; e <= epoch && e <= rec->last_epoch + 3; e++){
+	cl_reclaim_list(rec->limbo[(e + 1) % 3]);
+	rec->limbo[(e + 1) % 3] = NULL;
+    }
+    rec->last_epoch = epoch;
+
+    return rec;
+}
+
+static void
+cl_exit(cl_thread_rec *rec){
+    if (--rec->nesting == 0)
+	atomic_store_explicit(&rec->state, 0, memory_order_release);
+}
+
+/* Defer reclaiming 'r', which has been made unreachable */
+static void
+cl_defer(cl_thread_rec *rec, cl_retired *r){
+    uint64_t tag = atomic_load(&cl_global_epoch);
+
+    r->next = rec->limbo[tag % 3];
+    rec->limbo[tag % 3] = r;
+
+    if (++rec->retired_count % CL_ADVANCE_INTERVAL == 0)
+	cl_try_advance();
+}
+
+/* Lowest bit of the next pointer marks the node as removed */
+#define CL_MARK 1
+#define CL_IS_MARKED(p) (((p) & CL_MARK) != 0)
+#define CL_PTR(p) ((cl_node *) ((p) & ~(uintptr_t) CL_MARK))
+
+static void
+cl_reclaim_node(cl_retired *r){
+    free(r);
+}
+
+/* Data retired by cl_retire() */
+typedef struct cl_retired_data {
+    cl_retired retired; /* must be the first member */
+    void *data;
+    void (*free_cb)(void *data);
+} cl_retired_data;
+
+static void
+cl_reclaim_data(cl_retired *r){
+    cl_retired_data *rd = (cl_retired_data *) r;
+
+    rd->free_cb(rd->data);
+    free(rd);
+}
+
+static int
+cl_compare_key(concurrent_list *cl, cl_node *n, void *key){
+    return cl->key_compare_cb(n->key, key, cl->keys_compare_metadata);
+}
+
+/*
+ * Find the first node whose key is equal to or larger than
+ * 'key' and set 'curr' to it and 'prev' to its previous node.
+ * Unlink marked nodes on the way. Return true if the key of
+ * 'curr' equals to 'key'. Must be called in an epoch.
+ */
+static bool
+cl_find(concurrent_list *cl, cl_thread_rec *rec, void *key,
+	cl_node **prev, cl_node **curr){
+    cl_node *p, *c;
+    uintptr_t next, expected;
+    int cmp;
+
+retry:
+    p = &cl->head;
+    c = CL_PTR(atomic_load_explicit(&p->next, memory_order_acquire));
+    while(c != NULL){
+	next = atomic_load_explicit(&c->next, memory_order_acquire);
+
+	if (CL_IS_MARKED(next)){
+	    /* Help to unlink the removed node */
+	    expected = (uintptr_t) c;
+	    if (!atomic_compare_exchange_strong_explicit(&p->next, &expected,
+							 (uintptr_t) CL_PTR(next),
+							 memory_order_acq_rel,
+							 memory_order_acquire))
+		goto retry;
+	    cl_defer(rec, &c->retired);
+	    c = CL_PTR(next);
+	    continue;
+	}
+
+	if ((cmp = cl_compare_key(cl, c, key)) >= 0){
+	    *prev = p;
+	    *curr = c;
+	    return cmp == 0;
+	}
+	p = c;
+	c = CL_PTR(next);
+    }
+
+    *prev = p;
+    *curr = NULL;
+
+    return false;
+}
+
+concurrent_list *
+cl_init(void *(*key_access_cb)(void *data),
+	int (*key_compare_cb)(void *key1,
+			      void *key2,
+			      void *key_compare_metadata),
+	void (*free_cb)(void *data),
+	void *keys_compare_metadata){
+    concurrent_list *new_cl;
+
+    assert(key_compare_cb != NULL);
+
+    if ((new_cl = (concurrent_list *) malloc(sizeof(concurrent_list))) == NULL){
+	perror("malloc");
+	exit(-1);
+    }
+
+    new_cl->head.data = new_cl->head.key = NULL;
+    atomic_init(&new_cl->head.next, 0);
+    atomic_init(&new_cl->node_count, 0);
+
+    new_cl->key_access_cb = key_access_cb;
+    new_cl->key_compare_cb = key_compare_cb;
+    new_cl->free_cb = free_cb;
+    new_cl->keys_compare_metadata = keys_compare_metadata;
+
+    return new_cl;
+}
+
+int
+cl_get_length(concurrent_list *cl){
+    return atomic_load(&cl->node_count);
+}
+
+bool
+cl_insert(concurrent_list *cl, void *data){
+    cl_thread_rec *rec;
+    cl_node *n, *prev, *curr;
+    uintptr_t expected;
+
+    if (cl == NULL)
+	return false;
+
+    if ((n = (cl_node *) malloc(sizeof(cl_node))) == NULL){
+	perror("malloc");
+	exit(-1);
+    }
+    n->retired.reclaim = cl_reclaim_node;
+    n->data = data;
+    n->key = cl->key_access_cb == NULL ? data : cl->key_access_cb(data);
+
+    rec = cl_enter();
+    for (;;){
+	if (cl_find(cl, rec, n->key, &prev, &curr)){
+	    cl_exit(rec);
+	    free(n);
+	    return false;
+	}
+
+	atomic_store_explicit(&n->next, (uintptr_t) curr,
+			      memory_order_relaxed);
+	expected = (uintptr_t) curr;
+	if (atomic_compare_exchange_strong_explicit(&prev->next, &expected,
+						    (uintptr_t) n,
+						    memory_order_acq_rel,
+						    memory_order_acquire))
+	    break;
+    }
+    cl_exit(rec);
+
+    atomic_fetch_add(&cl->node_count, 1);
+
+    return true;
+}
+
+/* Walk without any write, skipping the marked nodes */
+void *
+cl_search_by_key(concurrent_list *cl, void *key){
+    cl_thread_rec *rec;
+    cl_node *n;
+    uintptr_t next;
+    void *data = NULL;
+    int cmp = -1;
+
+    if (cl == NULL || key == NULL)
+	return NULL;
+
+    rec = cl_enter();
+    n = CL_PTR(atomic_load_explicit(&cl->head.next, memory_order_acquire));
+    while(n != NULL){
+	next = atomic_load_explicit(&n->next, memory_order_acquire);
+	if ((cmp = cl_compare_key(cl, n, key)) >= 0){
+	    if (cmp == 0 && !CL_IS_MARKED(next))
+		data = n->data;
+	    break;
+	}
+	n = CL_PTR(next);
+    }
+    cl_exit(rec);
+
+    return data;
+}
+
+bool
+cl_has_key(concurrent_list *cl, void *key){
+    return cl_search_by_key(cl, key) != NULL;
+}
+
+void *
+cl_remove_by_key(concurrent_list *cl, void *key){
+    cl_thread_rec *rec;
+    cl_node *prev, *curr;
+    uintptr_t next, expected;
+    void *data;
+
+    if (cl == NULL || key == NULL)
+	return NULL;
+
+    rec = cl_enter();
+    for (;;){
+	if (!cl_find(cl, rec, key, &prev, &curr)){
+	    cl_exit(rec);
+	    return NULL;
+	}
+
+	/* Logical deletion. The thread which marks the node wins */
+	next = atomic_load_explicit(&curr->next, memory_order_acquire);
+	if (CL_IS_MARKED(next))
+	    continue;
+	if (atomic_compare_exchange_strong_explicit(&curr->next, &next,
+						    next | CL_MARK,
+						    memory_order_acq_rel,
+						    memory_order_acquire))
+	    break;
+    }
+    data = curr->data;
+
+    /* Physical deletion. Otherwise, a later walk unlinks it */
+    expected = (uintptr_t) curr;
+    if (atomic_compare_exchange_strong_explicit(&prev->next, &expected,
+						next, memory_order_acq_rel,
+						memory_order_acquire))
+	cl_defer(rec, &curr->retired);
+    else
+	cl_find(cl, rec, key, &prev, &curr);
+    cl_exit(rec);
+
+    atomic_fetch_sub(&cl->node_count, 1);
+
+    return data;
+}
+
+void
+cl_retire(concurrent_list *cl, void *data){
+    cl_thread_rec *rec;
+    cl_retired_data *rd;
+
+    if (cl == NULL || cl->free_cb == NULL || data == NULL)
+	return;
+
+    if ((rd = (cl_retired_data *) malloc(sizeof(cl_retired_data))) == NULL){
+	perror("malloc");
+	exit(-1);
+    }
+    rd->retired.reclaim = cl_reclaim_data;
+    rd->data = data;
+    rd->free_cb = cl->free_cb;
+
+    rec = cl_enter();
+    cl_defer(rec, &rd->retired);
+    cl_exit(rec);
+}
+
+void
+cl_for_each(concurrent_list *cl, void (*cb)(void *data, void *arg),
+	    void *arg){
+    cl_node *n;
+    uintptr_t next;
+
+    if (cl == NULL || cb == NULL)
+	return;
+
+    for (n = CL_PTR(atomic_load(&cl->head.next)); n != NULL; n = CL_PTR(next)){
+	next = atomic_load(&n->next);
+	if (!CL_IS_MARKED(next))
+	    cb(n->data, arg);
+    }
+}
+
+void
+cl_destroy(concurrent_list *cl){
+    cl_thread_rec *rec;
+    cl_node *n;
+    uintptr_t next;
+    int i;
+
+    if (cl == NULL)
+	return;
+
+    for (n = CL_PTR(atomic_load(&cl->head.next)); n != NULL; n = CL_PTR(next)){
+	next = atomic_load(&n->next);
+	if (!CL_IS_MARKED(next) && cl->free_cb != NULL && n->data != NULL)
+	    cl->free_cb(n->data);
+	free(n);
+    }
+
+    /*
+     * Reclaim what this thread retired as far as possible. The
+     * epoch doesn't advance while other threads are running.
+     */
+    for (i = 0; i < 3; i++){
+	cl_try_advance();
+	rec = cl_enter();
+	cl_exit(rec);
+    }
+
+    free(cl);
+}
@@ -0,0 +1,92 @@
+#ifndef __CONCURRENT_LIST__
+#define __CONCURRENT_LIST__
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Lock-free sorted list (Harris-Michael).
+ *
+ * Unlike linked_list, any number of threads may call cl_insert(),
+ * cl_search_by_key(), cl_has_key(), cl_remove_by_key() and
+ * cl_retire() on the same list at the same time. The keys are
+ * kept in ascending order and unique.
+ *
+ * A removed node is first marked in its next pointer (logical
+ * deletion) and then unlinked with CAS, by the remover or by any
+ * thread which walks over it. Unlinked nodes are freed through
+ * epoch-based reclamation, once no thread can still be reading
+ * them.
+ *
+ * Data returned by cl_search_by_key() may be removed by another
+ * thread at any time. So, don't free removed data directly, but
+ * pass it to cl_retire(), which calls free_cb when no concurrent
+ * operation can touch it anymore.
+ */
+
+/* Reclaimed when no thread can reference it. Internal */
+typedef struct cl_retired {
+    struct cl_retired *next;
+    void (*reclaim)(struct cl_retired *r);
+} cl_retired;
+
+typedef struct cl_node {
+    cl_retired retired; /* must be the first member */
+    void *data;
+    /* Key of the data, extracted once at insertion */
+    void *key;
+    /* Next node. The lowest bit marks this node as removed */
+    _Atomic uintptr_t next;
+} cl_node;
+
+typedef struct concurrent_list {
+
+    /* Sentinel before the first node */
+    cl_node head;
+
+    /* Approximate while operations are in progress */
+    _Atomic uintptr_t node_count;
+
+    /* Same as the callbacks of linked_list */
+    void *(*key_access_cb)(void *data);
+    int (*key_compare_cb)(void *key1,
+			  void *key2,
+			  void *key_compare_metadata);
+    void (*free_cb)(void *data);
+    void *keys_compare_metadata;
+
+} concurrent_list;
+
+concurrent_list *cl_init(void *(*key_access_cb)(void *data),
+			 int (*key_compare_cb)(void *key1,
+					       void *key2,
+					       void *metadata),
+			 void (*free_cb)(void *data),
+			 void *key_compare_metadata);
+
+int cl_get_length(concurrent_list *cl);
+
+/* Return false when the key already exists */
+bool cl_insert(concurrent_list *cl, void *data);
+bool cl_has_key(concurrent_list *cl, void *key);
+void *cl_search_by_key(concurrent_list *cl, void *key);
+void *cl_remove_by_key(concurrent_list *cl, void *key);
+
+/* Call free_cb for removed data when it is safe */
+void cl_retire(concurrent_list *cl, void *data);
+
+/*
+ * Call 'cb' for every data in ascending order of keys. Not
+ * thread-safe: call this when no other thread uses the list.
+ */
+void cl_for_each(concurrent_list *cl, void (*cb)(void *data, void *arg),
+		 void *arg);
+
+/*
+ * Free the remaining nodes and call free_cb for their data.
+ * No other thread may use the list at the same time or later.
+ */
+void cl_destroy(concurrent_list *cl);
+
+#endif
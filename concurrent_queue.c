@@ -0,0 +1,164 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "concurrent_queue.h"
+
+concurrent_queue *
+cq_init(void (*free_cb)(void *data)){
+    return cq_init_with_attr(free_cb, NULL);
+}
+
+concurrent_queue *
+cq_init_with_attr(void (*free_cb)(void *data), const cq_attr *attr){
+    concurrent_queue *new_q;
+
+    if ((new_q = (concurrent_queue *) malloc(sizeof(concurrent_queue))) == NULL){
+	perror("malloc");
+	exit(-1);
+    }
+
+    atomic_init(&new_q->stub.next, NULL);
+    new_q->stub.data = NULL;
+    atomic_init(&new_q->head, &new_q->stub);
+    new_q->tail = &new_q->stub;
+
+    new_q->free_cb = free_cb;
+
+    /* Optional settings */
+    if (attr != NULL)
+	new_q->attr = *attr;
+    else
+	memset(&new_q->attr, 0, sizeof(cq_attr));
+
+    return new_q;
+}
+
+bool
+cq_enqueue(concurrent_queue *q, void *data){
+    cq_node *n, *prev;
+
+    if (q == NULL || data == NULL)
+	return false;
+
+    if ((n = (cq_node *) malloc(sizeof(cq_node))) == NULL){
+	perror("malloc");
+	exit(-1);
+    }
+    atomic_store_explicit(&n->next, NULL, memory_order_relaxed);
+    n->data = data;
+
+    /* Take the last position, then link the previous node to it */
+    if (q->attr.single_producer){
+	prev = atomic_load_explicit(&q->head, memory_order_relaxed);
+	atomic_store_explicit(&q->head, n, memory_order_relaxed);
+    }else{
+	prev = atomic_exchange_explicit(&q->head, n, memory_order_acq_rel);
+    }
+    atomic_store_explicit(&prev->next, n, memory_order_release);
+
+    return true;
+}
+
+/*
+ * Return the first node with data, or NULL. The node becomes
+ * the new tail once its data is taken, and the old tail is freed.
+ */
+static cq_node *
+cq_first(concurrent_queue *q){
+    return atomic_load_explicit(&q->tail->next, memory_order_acquire);
+}
+
+static void
+cq_advance(concurrent_queue *q, cq_node *next){
+    cq_node *old = q->tail;
+
+    q->tail = next;
+    next->data = NULL;
+    if (old != &q->stub)
+	free(old);
+}
+
+void *
+cq_dequeue(concurrent_queue *q){
+    cq_node *next;
+    void *data;
+
+    if (q == NULL || (next = cq_first(q)) == NULL)
+	return NULL;
+
+    data = next->data;
+    cq_advance(q, next);
+
+    return data;
+}
+
+/*
+ * Walk the published chain from the tail once, then detach it by
+ * one update of the tail and free the consumed nodes after that.
+ */
+size_t
+cq_dequeue_batch(concurrent_queue *q, void **items, size_t max){
+    cq_node *old_tail, *last, *next, *n;
+    size_t count = 0;
+
+    if (q == NULL || items == NULL)
+	return 0;
+
+    old_tail = last = q->tail;
+    while(count < max &&
+	  (next = atomic_load_explicit(&last->next,
+				       memory_order_acquire)) != NULL){
+	items[count++] = next->data;
+	last = next;
+    }
+
+    if (count == 0)
+	return 0;
+
+    /* The last consumed node becomes the new tail */
+    q->tail = last;
+    last->data = NULL;
+
+    for (n = old_tail; n != last; n = next){
+	next = atomic_load_explicit(&n->next, memory_order_relaxed);
+	if (n != &q->stub)
+	    free(n);
+    }
+
+    return count;
+}
+
+bool
+cq_is_empty(concurrent_queue *q){
+    assert(q != NULL);
+
+    return cq_first(q) == NULL;
+}
+
+void
+cq_drain(concurrent_queue *q){
+    void *data;
+
+    if (q == NULL)
+	return;
+
+    while((data = cq_dequeue(q)) != NULL){
+	if (q->free_cb)
+	    q->free_cb(data);
+    }
+}
+
+void
+cq_destroy(concurrent_queue *q){
+    if (q == NULL)
+	return;
+
+    cq_drain(q);
+
+    /* The last consumed node remains as the tail */
+    if (q->tail != &q->stub)
+	free(q->tail);
+
+    free(q);
+}
@@ -0,0 +1,88 @@
+#ifndef __CONCURRENT_QUEUE__
+#define __CONCURRENT_QUEUE__
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Lock-free FIFO queue between threads (Vyukov's MPSC queue).
+ *
+ * Any number of producer threads may call cq_enqueue() at the
+ * same time. It is wait-free: one atomic exchange and one store.
+ * One consumer thread at a time calls cq_dequeue(),
+ * cq_dequeue_batch(), cq_drain() or cq_is_empty().
+ *
+ * An enqueue becomes visible to the consumer when its second
+ * step, the store, is done. Until then, the consumer regards the
+ * queue as ending just before it, even when later enqueues have
+ * already been done.
+ */
+typedef struct cq_node {
+    _Atomic(struct cq_node *) next;
+    void *data;
+} cq_node;
+
+/*
+ * Optional settings of concurrent_queue, passed to cq_init_with_attr().
+ *
+ * Zero-initialized members keep the default behavior of cq_init().
+ */
+typedef struct cq_attr {
+
+    /*
+     * Only one producer thread calls cq_enqueue() at a time.
+     * Enqueue then does no atomic read-modify-write at all.
+     */
+    bool single_producer;
+
+} cq_attr;
+
+typedef struct concurrent_queue {
+
+    /* Last enqueued node. Producers append here */
+    _Atomic(cq_node *) head;
+
+    /*
+     * Node before the first data, already consumed. Owned by
+     * the consumer
+     */
+    cq_node *tail;
+
+    /* Initial node, never freed */
+    cq_node stub;
+
+    /* Called for the data left in the queue by cq_drain() and cq_destroy() */
+    void (*free_cb)(void *data);
+
+    /* Settings given at initialization */
+    cq_attr attr;
+
+} concurrent_queue;
+
+concurrent_queue *cq_init(void (*free_cb)(void *data));
+concurrent_queue *cq_init_with_attr(void (*free_cb)(void *data),
+				    const cq_attr *attr);
+
+/* NULL data can't be enqueued. Return false for it */
+bool cq_enqueue(concurrent_queue *q, void *data);
+
+/* Return NULL when the queue is empty */
+void *cq_dequeue(concurrent_queue *q);
+
+/*
+ * Dequeue up to 'max' data into 'items' and return the number of
+ * them. The chain published so far is copied out in one walk and
+ * detached at once, and its nodes are freed afterward.
+ */
+size_t cq_dequeue_batch(concurrent_queue *q, void **items, size_t max);
+
+bool cq_is_empty(concurrent_queue *q);
+
+/* Dequeue all data and call free_cb for them */
+void cq_drain(concurrent_queue *q);
+
+/* No other thread may use the queue at the same time or later */
+void cq_destroy(concurrent_queue *q);
+
+#endif
@@ -0,0 +1,318 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "intrusive_list.h"
+
+#define IL_LINK(il, obj) ((ll_link *) ((char *) (obj) + (il)->link_offset))
+#define IL_OBJ(il, link) ((void *) ((char *) (link) - (il)->link_offset))
+
+/*
+ * Connect 'link' just after 'prev'. 'link' must be initialized by
+ * LL_LINK_INIT() or zero-filled, as intrusive_list.h requires.
+ */
+static void
+il_link_after(intrusive_list *il, ll_link *prev, ll_link *link){
+    assert(link->next == NULL && link->prev == NULL);
+
+    link->prev = prev;
+    link->next = prev->next;
+    prev->next->prev = link;
+    prev->next = link;
+    il->link_count++;
+}
+
+static void
+il_unlink(intrusive_list *il, ll_link *link){
+    assert(link->next != NULL && link->prev != NULL);
+
+    /* Keep the iteration valid */
+    if (il->current_link == link)
+	il->current_link = link->next;
+
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+    LL_LINK_INIT(link);
+    il->link_count--;
+}
+
+static void *
+il_obj_key(intrusive_list *il, void *obj){
+    return il->key_access_cb == NULL ? obj : il->key_access_cb(obj);
+}
+
+/* Return the first link whose key equals to 'key', or NULL */
+static ll_link *
+il_find_link(intrusive_list *il, void *key){
+    ll_link *link;
+
+    for (link = il->anchor.next; link != &il->anchor; link = link->next)
+	if (il->key_compare_cb(il_obj_key(il, IL_OBJ(il, link)), key,
+			       il->keys_compare_metadata) == 0)
+	    return link;
+
+    return NULL;
+}
+
+intrusive_list *
+il_init(size_t link_offset,
+	void *(*key_access_cb)(void *data),
+	int (*key_compare_cb)(void *key1,
+			      void *key2,
+			      void *key_compare_metadata),
+	void *keys_compare_metadata){
+    intrusive_list *new_il;
+
+    if ((new_il = (intrusive_list *) malloc(sizeof(intrusive_list))) == NULL){
+	perror("malloc");
+	exit(-1);
+    }
+
+    new_il->anchor.next = new_il->anchor.prev = &new_il->anchor;
+    new_il->link_count = 0;
+    new_il->link_offset = link_offset;
+
+    new_il->key_access_cb = key_access_cb;
+    new_il->key_compare_cb = key_compare_cb;
+    new_il->keys_compare_metadata = keys_compare_metadata;
+
+    new_il->current_link = NULL;
+    new_il->iter_in_progress = false;
+
+    return new_il;
+}
+
+bool
+il_is_empty(intrusive_list *il){
+    assert(il != NULL);
+
+    return il->link_count == 0;
+}
+
+/* Is 'obj' in some list through the member of this list ? */
+bool
+il_is_linked(intrusive_list *il, void *obj){
+    return IL_LINK(il, obj)->next != NULL;
+}
+
+int
+il_get_length(intrusive_list *il){
+    return il->link_count;
+}
+
+bool
+il_has_key(intrusive_list *il, void *key){
+    if (il == NULL || il->link_count == 0 || il->key_compare_cb == NULL)
+	return false;
+
+    return il_find_link(il, key) != NULL;
+}
+
+void
+il_insert(intrusive_list *il, void *obj){
+    if (!il || !obj)
+	return;
+
+    il_link_after(il, &il->anchor, IL_LINK(il, obj));
+}
+
+void
+il_tail_insert(intrusive_list *il, void *obj){
+    if (!il || !obj)
+	return;
+
+    il_link_after(il, il->anchor.prev, IL_LINK(il, obj));
+}
+
+/* Insert 'obj' just after 'pos', which must be in the list */
+void
+il_insert_after(intrusive_list *il, void *pos, void *obj){
+    if (!il || !pos || !obj)
+	return;
+
+    il_link_after(il, IL_LINK(il, pos), IL_LINK(il, obj));
+}
+
+/*
+ * Insert an object in ascending order and return the
+ * index of inserted position, like ll_asc_insert().
+ */
+int
+il_asc_insert(intrusive_list *il, void *obj){
+    ll_link *prev;
+    void *key;
+    int inserted_pos = 0;
+
+    if (!il || !obj)
+	return -1;
+
+    key = il_obj_key(il, obj);
+    for (prev = &il->anchor; prev->next != &il->anchor; prev = prev->next){
+	if (il->key_compare_cb(il_obj_key(il, IL_OBJ(il, prev->next)), key,
+			       il->keys_compare_metadata) > 0)
+	    break;
+	inserted_pos++;
+    }
+    il_link_after(il, prev, IL_LINK(il, obj));
+
+    return inserted_pos;
+}
+
+/* Remove 'obj', which must be in the list, without any walk */
+void
+il_remove(intrusive_list *il, void *obj){
+    if (!il || !obj)
+	return;
+
+    il_unlink(il, IL_LINK(il, obj));
+}
+
+void *
+il_remove_first_data(intrusive_list *il){
+    ll_link *link;
+
+    if (il == NULL || il->link_count == 0)
+	return NULL;
+
+    link = il->anchor.next;
+    il_unlink(il, link);
+
+    return IL_OBJ(il, link);
+}
+
+void *
+il_tail_remove(intrusive_list *il){
+    ll_link *link;
+
+    if (il == NULL || il->link_count == 0)
+	return NULL;
+
+    link = il->anchor.prev;
+    il_unlink(il, link);
+
+    return IL_OBJ(il, link);
+}
+
+/* Walk from the nearer end */
+void *
+il_ref_index_data(intrusive_list *il, int index){
+    ll_link *link;
+    int i;
+
+    if (il == NULL || index < 0 || il_get_length(il) <= index)
+	return NULL;
+
+    if (index < il_get_length(il) / 2){
+	for (link = il->anchor.next, i = 0; i < index; i++)
+	    link = link->next;
+    }else{
+	for (link = il->anchor.prev, i = il_get_length(il) - 1; i > index; i--)
+	    link = link->prev;
+    }
+
+    return IL_OBJ(il, link);
+}
+
+/* Return the object after 'obj', or NULL if 'obj' is the last one */
+void *
+il_next(intrusive_list *il, void *obj){
+    ll_link *next = IL_LINK(il, obj)->next;
+
+    return next == &il->anchor ? NULL : IL_OBJ(il, next);
+}
+
+/* Return the object before 'obj', or NULL if 'obj' is the first one */
+void *
+il_prev(intrusive_list *il, void *obj){
+    ll_link *prev = IL_LINK(il, obj)->prev;
+
+    return prev == &il->anchor ? NULL : IL_OBJ(il, prev);
+}
+
+/* Don't remove the hit object from the list */
+void *
+il_search_by_key(intrusive_list *il, void *key){
+    ll_link *link;
+
+    if (!il || il->link_count == 0 || !key || !il->key_compare_cb)
+	return NULL;
+
+    if ((link = il_find_link(il, key)) == NULL)
+	return NULL;
+
+    return IL_OBJ(il, link);
+}
+
+void *
+il_remove_by_key(intrusive_list *il, void *key){
+    ll_link *link;
+
+    if (!il || il->link_count == 0 || !key || !il->key_compare_cb)
+	return NULL;
+
+    if ((link = il_find_link(il, key)) == NULL)
+	return NULL;
+    il_unlink(il, link);
+
+    return IL_OBJ(il, link);
+}
+
+/* Unlink all objects. The objects themselves are left to the application */
+void
+il_remove_all(intrusive_list *il){
+    ll_link *link, *next;
+
+    if (il == NULL)
+	return;
+
+    for (link = il->anchor.next; link != &il->anchor; link = next){
+	next = link->next;
+	LL_LINK_INIT(link);
+    }
+
+    il->anchor.next = il->anchor.prev = &il->anchor;
+    il->link_count = 0;
+}
+
+void
+il_begin_iter(intrusive_list *il){
+    assert(il->iter_in_progress == false);
+    assert(il->current_link == NULL);
+
+    il->iter_in_progress = true;
+    /* Set the link which will be referenced next */
+    il->current_link = il->anchor.next;
+}
+
+void *
+il_get_iter_data(intrusive_list *il){
+    ll_link *link;
+
+    assert(il->iter_in_progress == true);
+
+    link = il->current_link;
+    if (link == &il->anchor)
+	return NULL;
+
+    /* Shift the link to the next one for the next call */
+    il->current_link = link->next;
+
+    return IL_OBJ(il, link);
+}
+
+void
+il_end_iter(intrusive_list *il){
+    assert(il->iter_in_progress == true);
+
+    il->iter_in_progress = false;
+    il->current_link = NULL;
+}
+
+void
+il_destroy(intrusive_list *il){
+    if (il == NULL)
+	return;
+
+    il_remove_all(il);
+
+    free(il);
+}
@@ -0,0 +1,119 @@
+#ifndef __INTRUSIVE_LIST__
+#define __INTRUSIVE_LIST__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Intrusive doubly-linked list.
+ *
+ * The application embeds an ll_link in its own structure and
+ * passes the containing objects to the il_ functions. The list
+ * links the embedded ll_link members, so it never allocates
+ * nor frees anything per object, and an object is removed in
+ * O(1) given its pointer.
+ *
+ *	typedef struct connection {
+ *	    int fd;
+ *	    ll_link link;
+ *	} connection;
+ *
+ *	il = il_init(offsetof(connection, link), NULL, NULL, NULL);
+ *	LL_LINK_INIT(&conn->link);
+ *	il_tail_insert(il, conn);
+ *	...
+ *	il_remove(il, conn);
+ *
+ * Initialize each ll_link by LL_LINK_INIT() or zero-fill it before
+ * its first insertion. The insertions assert that the link is
+ * unlinked, and il_is_linked() tells it from the NULL links, so
+ * garbage in a link of a recycled or pooled object breaks both.
+ * il_remove() and the other removals leave the link initialized.
+ *
+ * An object can be in one intrusive list per ll_link member at
+ * a time. The functions correspond to the ll_ functions of the
+ * same names in linked_list.h, except that data means the
+ * containing object.
+ */
+typedef struct ll_link {
+    struct ll_link *next;
+    struct ll_link *prev;
+} ll_link;
+
+/* Return the object of 'type' which contains 'link' as 'member' */
+#define LL_CONTAINER_OF(link, type, member) \
+    ((type *) ((char *) (link) - offsetof(type, member)))
+
+/*
+ * Make 'link' unlinked. il_is_linked() is false for it. Required
+ * before the first insertion unless the link is zero-filled.
+ */
+#define LL_LINK_INIT(link) ((link)->next = (link)->prev = NULL)
+
+typedef struct intrusive_list {
+
+    /*
+     * The links form a circle through this anchor, so that no
+     * insertion or removal needs to care about the ends.
+     */
+    ll_link anchor;
+
+    uintptr_t link_count;
+
+    /* Offset of the ll_link member in the objects */
+    size_t link_offset;
+
+    /* Same as the callbacks of linked_list */
+    void *(*key_access_cb)(void *data);
+    int (*key_compare_cb)(void *key1,
+			  void *key2,
+			  void *key_compare_metadata);
+    void *keys_compare_metadata;
+
+    /* Iteration control */
+    ll_link *current_link;
+    bool iter_in_progress;
+
+} intrusive_list;
+
+intrusive_list *il_init(size_t link_offset,
+			void *(*key_access_cb)(void *data),
+			int (*key_compare_cb)(void *key1,
+					      void *key2,
+					      void *metadata),
+			void *key_compare_metadata);
+
+bool il_is_empty(intrusive_list *il);
+bool il_is_linked(intrusive_list *il, void *obj);
+bool il_has_key(intrusive_list *il, void *key);
+int il_get_length(intrusive_list *il);
+
+/* Basic operations (insert, delete, search ... etc) */
+void il_insert(intrusive_list *il, void *obj);
+void il_tail_insert(intrusive_list *il, void *obj);
+void il_insert_after(intrusive_list *il, void *pos, void *obj);
+int il_asc_insert(intrusive_list *il, void *obj);
+void il_remove(intrusive_list *il, void *obj);
+void *il_remove_first_data(intrusive_list *il);
+void *il_tail_remove(intrusive_list *il);
+void *il_ref_index_data(intrusive_list *il, int index);
+void *il_next(intrusive_list *il, void *obj);
+void *il_prev(intrusive_list *il, void *obj);
+void *il_search_by_key(intrusive_list *il, void *key);
+void *il_remove_by_key(intrusive_list *il, void *key);
+void il_remove_all(intrusive_list *il);
+
+/*
+ * iteration feature
+ *
+ * The object returned last by il_get_iter_data() may be removed
+ * during the iteration.
+ */
+void il_begin_iter(intrusive_list *il);
+void *il_get_iter_data(intrusive_list *il);
+void il_end_iter(intrusive_list *il);
+
+void il_destroy(intrusive_list *il);
+
+#endif
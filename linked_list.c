@@ -1,558 +1,3109 @@
 #include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 #include "linked_list.h"
 
+/* Position of a node which isn't known to the caller */
+#define LL_UNKNOWN_INDEX UINTPTR_MAX
+
+/* Prefetch distance of the lists without the prefetch_distance setting */
+#ifndef LL_PREFETCH_DISTANCE
+#define LL_PREFETCH_DISTANCE 0
+#endif
+
+/*
+ * Counters of ll_stats. They compile to nothing unless LL_STATS
+ * is defined, so that the default build pays nothing for them.
+ */
+#ifdef LL_STATS
+
+#define LL_STAT_ADD(ll, member, count) ((ll)->stats.member += (count))
+#define LL_STAT_SCAN(ll, visited) ll_stat_scan((ll), (visited))
+#define LL_STAT_MERGE(to, from) ll_stat_merge((to), (from))
+
+/* Account one walk which visited 'visited' nodes */
+static void
+ll_stat_scan(linked_list *ll, uint64_t visited){
+    ll->stats.nodes_visited += visited;
+    if (ll->stats.longest_scan < visited)
+	ll->stats.longest_scan = visited;
+}
+
+/* Add the counters taken on another thread */
+static void
+ll_stat_merge(ll_stats *to, const ll_stats *from){
+    to->nodes_visited += from->nodes_visited;
+    to->key_compare_calls += from->key_compare_calls;
+    to->key_access_calls += from->key_access_calls;
+    to->node_allocs += from->node_allocs;
+    to->node_frees += from->node_frees;
+    if (to->longest_scan < from->longest_scan)
+	to->longest_scan = from->longest_scan;
+}
+
+#else
+
+#define LL_STAT_ADD(ll, member, count) ((void) 0)
+#define LL_STAT_SCAN(ll, visited) ((void) (visited))
+#define LL_STAT_MERGE(to, from) ((void) 0)
+
+#endif
+
+/* Hook set by ll_set_trace_hook() */
+static ll_trace_cb ll_trace_hook;
+static void *ll_trace_arg;
+
+/* Start of a traced operation */
+typedef struct ll_trace_point {
+    uint64_t start_ns;
+    /* Visits counted by ll_stats so far */
+    uint64_t visited;
+} ll_trace_point;
+
+static uint64_t
+ll_now_ns(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Start the clock and return true if the operation on 'll' is
+ * traced. This one branch is all that it costs otherwise.
+ */
+static bool
+ll_trace_begin(linked_list *ll, ll_trace_point *tp){
+    if (ll == NULL || (ll_trace_hook == NULL && ll->latency == NULL))
+	return false;
+
+    tp->visited = ll->stats.nodes_visited;
+    tp->start_ns = ll_now_ns();
+
+    return true;
+}
+
+static void
+ll_latency_add(ll_latency *latency, uint64_t ns){
+    int bucket = 0;
+
+    if (ns > 0)
+	bucket = 63 - __builtin_clzll(ns);
+    if (bucket >= LL_LATENCY_BUCKETS)
+	bucket = LL_LATENCY_BUCKETS - 1;
+
+    latency->buckets[bucket]++;
+    latency->count++;
+    latency->total_ns += ns;
+    if (latency->max_ns < ns)
+	latency->max_ns = ns;
+}
+
+/* Record and report the operation started by ll_trace_begin() */
+static void
+ll_trace_end(linked_list *ll, ll_op op, const ll_trace_point *tp){
+    uint64_t ns = ll_now_ns() - tp->start_ns;
+
+    if (ll->latency != NULL)
+	ll_latency_add(&ll->latency[op], ns);
+
+    if (ll_trace_hook != NULL)
+	ll_trace_hook(op, ll, ll->stats.nodes_visited - tp->visited, ns,
+		      ll_trace_arg);
+}
+
+/*
+ * Slab of nodes. The nodes are laid out just after this
+ * header and handed out from the lowest address.
+ */
+typedef struct ll_slab {
+    struct ll_slab *next;
+} ll_slab;
+
+typedef struct ll_node_pool {
+    /* All slabs allocated so far. The newest one comes first */
+    ll_slab *slabs;
+
+    /* Released nodes, chained by their 'next' member */
+    node *free_nodes;
+
+    /* Nodes in the newest slab which have never been used */
+    char *unused;
+    uintptr_t unused_count;
+
+    unsigned int nodes_per_slab;
+    size_t node_size;
+
+    /* Number of nodes currently handed out */
+    uintptr_t nodes_in_use;
+
+    /*
+     * Number of lists sharing this pool. Lists created by
+     * ll_split() and ll_merge() share the pool of the input
+     * list, since the nodes are moved between them.
+     */
+    unsigned int refcount;
+} ll_node_pool;
+
+static ll_node_pool *
+ll_pool_create(unsigned int nodes_per_slab, size_t node_size){
+    ll_node_pool *pool;
+
+    if ((pool = (ll_node_pool *) malloc(sizeof(ll_node_pool))) == NULL){
+	perror("malloc");
+	exit(-1);
+    }
+
+    pool->slabs = NULL;
+    pool->free_nodes = NULL;
+    pool->unused = NULL;
+    pool->unused_count = 0;
+    pool->nodes_per_slab = nodes_per_slab;
+    pool->node_size = node_size;
+    pool->nodes_in_use = 0;
+    pool->refcount = 1;
+
+    return pool;
+}
+
+/* Add a new slab of 'count' nodes and carve nodes out of it */
+static void
+ll_pool_add_slab(ll_node_pool *pool, uintptr_t count){
+    ll_slab *slab;
+    node *n;
+
+    if ((slab = (ll_slab *) malloc(sizeof(ll_slab) +
+				   pool->node_size * count)) == NULL){
+	perror("malloc");
+	exit(-1);
+    }
+
+    /* Don't waste the rest of the current slab */
+    while(pool->unused_count > 0){
+	n = (node *) pool->unused;
+	n->next = pool->free_nodes;
+	pool->free_nodes = n;
+	pool->unused += pool->node_size;
+	pool->unused_count--;
+    }
+
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    pool->unused = (char *) (slab + 1);
+    pool->unused_count = count;
+}
+
+/*
+ * Make sure that the next 'count' nodes are carved out of
+ * one slab at most.
+ */
+static void
+ll_pool_reserve(ll_node_pool *pool, uintptr_t count){
+    if (pool->unused_count < count)
+	ll_pool_add_slab(pool, count > pool->nodes_per_slab ?
+			 count : pool->nodes_per_slab);
+}
+
+static node *
+ll_pool_get(ll_node_pool *pool){
+    node *n;
+
+    /* Reuse a released node first */
+    if ((n = pool->free_nodes) != NULL){
+	pool->free_nodes = n->next;
+	pool->nodes_in_use++;
+	return n;
+    }
+
+    if (pool->unused_count == 0)
+	ll_pool_add_slab(pool, pool->nodes_per_slab);
+
+    n = (node *) pool->unused;
+    pool->unused += pool->node_size;
+    pool->unused_count--;
+    pool->nodes_in_use++;
+
+    return n;
+}
+
+static void
+ll_pool_put(ll_node_pool *pool, node *n){
+    assert(pool->nodes_in_use > 0);
+
+    n->next = pool->free_nodes;
+    pool->free_nodes = n;
+    pool->nodes_in_use--;
+}
+
+/*
+ * Release all slabs at once. Any node taken from
+ * the pool must not be referenced after this.
+ */
+static void
+ll_pool_release_slabs(ll_node_pool *pool){
+    ll_slab *slab, *next;
+
+    for (slab = pool->slabs; slab != NULL; slab = next){
+	next = slab->next;
+	free(slab);
+    }
+
+    pool->slabs = NULL;
+    pool->free_nodes = NULL;
+    pool->unused = NULL;
+    pool->unused_count = 0;
+    pool->nodes_in_use = 0;
+}
+
+static void
+ll_pool_unref(ll_node_pool *pool){
+    assert(pool->refcount > 0);
+
+    if (--pool->refcount > 0)
+	return;
+
+    ll_pool_release_slabs(pool);
+    free(pool);
+}
+
+/*
+ * Node layout in the doubly-linked mode. Accessed only
+ * when the list was created with that mode.
+ */
+typedef struct ext_node {
+    node n; /* must be the first member */
+    node *prev;
+} ext_node;
+
+#define LL_PREV(n) (((ext_node *) (n))->prev)
+
+/*
+ * Key cached in a node, placed after the node layout above
+ * when the list caches keys. 'prefix' exists only when the
+ * list has key_prefix_cb.
+ */
+typedef struct ll_key_cache {
+    void *key;
+    uint64_t prefix;
+} ll_key_cache;
+
+#define LL_KEY_CACHE(ll, n) \
+    ((ll_key_cache *) ((char *) (n) + (ll)->key_offset))
+
+/* Return the key of the data through key_access_cb, if any */
+static void *
+ll_data_key(linked_list *ll, void *data){
+    if (ll->key_access_cb == NULL)
+	return data;
+
+    LL_STAT_ADD(ll, key_access_calls, 1);
+
+    return ll->key_access_cb(data);
+}
+
+/* Store the key of the data in the node */
+static void
+ll_cache_key(linked_list *ll, node *n){
+    ll_key_cache *cache = LL_KEY_CACHE(ll, n);
+
+    cache->key = ll_data_key(ll, n->data);
+    if (ll->attr.key_prefix_cb != NULL)
+	cache->prefix = ll->attr.key_prefix_cb(cache->key,
+					       ll->keys_compare_metadata);
+}
+
 static node*
-ll_gen_node(void *p){
+ll_gen_node(linked_list *ll, void *p){
     node *n;
 
-    if ((n = (node *) malloc(sizeof(node))) == NULL){
+    if (ll->pool != NULL)
+	n = ll_pool_get(ll->pool);
+    else if ((n = (node *) malloc(ll->node_size)) == NULL){
 	perror("malloc");
 	exit(-1);
     }
 
     n->data = p;
     n->next = NULL;
+    LL_STAT_ADD(ll, node_allocs, 1);
+
+    if (ll->key_offset != 0)
+	ll_cache_key(ll, n);
 
     return n;
 }
 
-linked_list *
-ll_init(void *(*key_access_cb)(void *data),
-	int (*key_compare_cb)(void *key1,
-			      void *key2,
-			      void *key_compare_metadata),
-	void (*free_cb)(void *data),
-	void *keys_compare_metadata){
-    linked_list *new_ll;
+static void
+ll_free_node(linked_list *ll, node *n){
+    LL_STAT_ADD(ll, node_frees, 1);
 
-    if ((new_ll = (linked_list *) malloc(sizeof(linked_list))) == NULL){
+    if (ll->pool != NULL)
+	ll_pool_put(ll->pool, n);
+    else
+	free(n);
+}
+
+/*
+ * Skip-list tower.
+ *
+ * Some nodes are promoted at random and get a tower, which has
+ * one forward link per level. Each link also records its width,
+ * that is, how many nodes it skips, so that the tower can be
+ * descended both by keys and by positions. The header is at the
+ * position 0, the nodes take the positions from 1 to node_count
+ * and a link without any next tower points to node_count + 1.
+ */
+#define LL_SKIP_MAX_LEVEL 16
+
+typedef struct ll_tower {
+    node *node;
+    int height;
+    struct {
+	struct ll_tower *next;
+	uintptr_t width;
+    } level[];
+} ll_tower;
+
+typedef struct ll_skip_index {
+    ll_tower *header;
+
+    /* Number of levels in use */
+    int level;
+
+    /* State of the generator of tower heights */
+    uint64_t seed;
+} ll_skip_index;
+
+static ll_tower *
+ll_tower_create(node *n, int height){
+    ll_tower *t;
+
+    if ((t = (ll_tower *) malloc(sizeof(ll_tower) +
+				 height * sizeof(t->level[0]))) == NULL){
 	perror("malloc");
 	exit(-1);
     }
 
-    new_ll->node_count = 0;
-    new_ll->head = NULL;
+    t->node = n;
+    t->height = height;
 
-    /* Set callbacks */
-    new_ll->key_access_cb = key_access_cb;
-    new_ll->key_compare_cb = key_compare_cb;
-    new_ll->free_cb = free_cb;
+    return t;
+}
 
-    /* Iteration control */
-    new_ll->current_node = NULL;
-    new_ll->iter_in_progress = false;
+/*
+ * Release all towers. The remaining header describes
+ * a list of 'node_count' nodes without any tower.
+ */
+static void
+ll_skip_clear(ll_skip_index *skip, uintptr_t node_count){
+    ll_tower *t, *next;
 
-    /* Set metadata for advanced keys comparsion */
-    new_ll->keys_compare_metadata = keys_compare_metadata;
+    for (t = skip->header->level[0].next; t != NULL; t = next){
+	next = t->level[0].next;
+	free(t);
+    }
 
-    return new_ll;
+    skip->level = 1;
+    skip->header->level[0].next = NULL;
+    skip->header->level[0].width = node_count + 1;
 }
 
-bool
-ll_is_empty(linked_list *ll){
-    assert(ll != NULL);
-	
-    if (ll->node_count == 0)
-	return true;
-    else
-	return false;
+static ll_skip_index *
+ll_skip_create(void){
+    ll_skip_index *skip;
+
+    if ((skip = (ll_skip_index *) malloc(sizeof(ll_skip_index))) == NULL){
+	perror("malloc");
+	exit(-1);
+    }
+
+    skip->header = ll_tower_create(NULL, LL_SKIP_MAX_LEVEL);
+    skip->header->level[0].next = NULL;
+    ll_skip_clear(skip, 0);
+    skip->seed = 0x9E3779B97F4A7C15ULL ^ (uintptr_t) skip;
+
+    return skip;
 }
 
-int
-ll_get_length(linked_list *ll){
-    return ll->node_count;
+static void
+ll_skip_destroy(ll_skip_index *skip){
+    ll_skip_clear(skip, 0);
+    free(skip->header);
+    free(skip);
 }
 
-void
-ll_insert(linked_list *ll, void *data){
-    node *new_node;
+/*
+ * Return the height of a new tower. Zero means the node
+ * doesn't get promoted.
+ */
+static int
+ll_skip_random_height(ll_skip_index *skip){
+    uint64_t x = skip->seed;
+    int height = 0;
+
+    /* xorshift64 */
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    skip->seed = x;
+
+    /* Promote to each level with the probability of 1/4 */
+    while(height < LL_SKIP_MAX_LEVEL && (x & 3) == 0){
+	height++;
+	x >>= 2;
+    }
 
-    if (!ll)
-	return;
+    return height;
+}
 
-    new_node = ll_gen_node(data);
-    ll->node_count++;
-    if (!ll->head){
-	ll->head = new_node;
-	return;
+/*
+ * Collect the last tower before the position 'pos' at each
+ * level, and their positions.
+ */
+static void
+ll_skip_descend(ll_skip_index *skip, uintptr_t pos,
+		ll_tower **update, uintptr_t *rank){
+    ll_tower *x = skip->header;
+    uintptr_t x_pos = 0;
+    int l;
+
+    for (l = skip->level - 1; l >= 0; l--){
+	while(x->level[l].next != NULL &&
+	      x_pos + x->level[l].width < pos){
+	    x_pos += x->level[l].width;
+	    x = x->level[l].next;
+	}
+	update[l] = x;
+	rank[l] = x_pos;
+    }
+}
+
+/*
+ * Account a node inserted at the position 'pos'. Call this
+ * before the node count is incremented.
+ */
+static void
+ll_skip_insert(linked_list *ll, uintptr_t pos, node *n){
+    ll_skip_index *skip = ll->skip;
+    ll_tower *update[LL_SKIP_MAX_LEVEL], *t;
+    uintptr_t rank[LL_SKIP_MAX_LEVEL], next_pos;
+    int height, l;
+
+    ll_skip_descend(skip, pos, update, rank);
+
+    height = ll_skip_random_height(skip);
+    for (l = skip->level; l < height; l++){
+	skip->header->level[l].next = NULL;
+	skip->header->level[l].width = ll->node_count + 1;
+	update[l] = skip->header;
+	rank[l] = 0;
+    }
+    if (height > skip->level)
+	skip->level = height;
+
+    if (height > 0){
+	t = ll_tower_create(n, height);
+	for (l = 0; l < height; l++){
+	    /* The next tower gets shifted by the new node */
+	    next_pos = rank[l] + update[l]->level[l].width + 1;
+
+	    t->level[l].next = update[l]->level[l].next;
+	    t->level[l].width = next_pos - pos;
+	    update[l]->level[l].next = t;
+	    update[l]->level[l].width = pos - rank[l];
+	}
     }
 
-    new_node->next = ll->head;
-    ll->head = new_node;
+    /* Higher links now skip one more node */
+    for (l = height; l < skip->level; l++)
+	update[l]->level[l].width++;
 }
 
-void
-ll_tail_insert(linked_list *ll, void *data){
-    node *new_node;
+/* Account the removal of the node at the position 'pos' */
+static void
+ll_skip_remove(linked_list *ll, uintptr_t pos){
+    ll_skip_index *skip = ll->skip;
+    ll_tower *update[LL_SKIP_MAX_LEVEL], *t = NULL, *next;
+    uintptr_t rank[LL_SKIP_MAX_LEVEL];
+    int l;
+
+    ll_skip_descend(skip, pos, update, rank);
+
+    for (l = 0; l < skip->level; l++){
+	next = update[l]->level[l].next;
+	if (next != NULL && rank[l] + update[l]->level[l].width == pos){
+	    /* Bypass the tower of the removed node */
+	    update[l]->level[l].width += next->level[l].width - 1;
+	    update[l]->level[l].next = next->level[l].next;
+	    t = next;
+	}else{
+	    update[l]->level[l].width--;
+	}
+    }
+    free(t);
 
-    if (!ll)
-	return;
+    while(skip->level > 1 &&
+	  skip->header->level[skip->level - 1].next == NULL)
+	skip->level--;
+}
 
-    new_node = ll_gen_node(data);
-    ll->node_count++;
+/*
+ * Build the towers from scratch. Used after the nodes are
+ * relinked in bulk.
+ */
+static void
+ll_skip_rebuild(linked_list *ll){
+    ll_skip_index *skip = ll->skip;
+    ll_tower *last[LL_SKIP_MAX_LEVEL], *t;
+    uintptr_t last_pos[LL_SKIP_MAX_LEVEL], pos = 0;
+    node *n;
+    int height, l;
 
-    if (!ll->head){
-	ll->head = new_node;
-	return;
-    }else{
-	node *curr, *prev;
+    ll_skip_clear(skip, ll->node_count);
 
-	prev = curr = ll->head;
-	while(curr != NULL){
-	    prev = curr;
-	    curr = curr->next;
+    for (l = 0; l < LL_SKIP_MAX_LEVEL; l++){
+	last[l] = skip->header;
+	last_pos[l] = 0;
+    }
+
+    for (n = ll->head; n != NULL; n = n->next){
+	pos++;
+	if ((height = ll_skip_random_height(skip)) == 0)
+	    continue;
+
+	t = ll_tower_create(n, height);
+	for (l = 0; l < height; l++){
+	    last[l]->level[l].next = t;
+	    last[l]->level[l].width = pos - last_pos[l];
+	    last[l] = t;
+	    last_pos[l] = pos;
 	}
-	prev->next = new_node;
+	if (height > skip->level)
+	    skip->level = height;
+    }
+
+    for (l = 0; l < skip->level; l++){
+	last[l]->level[l].next = NULL;
+	last[l]->level[l].width = ll->node_count + 1 - last_pos[l];
     }
+
+    LL_STAT_SCAN(ll, pos);
 }
 
-void *
-ll_remove_first_data(linked_list *ll){
-    if (ll == NULL || ll->head == NULL)
-	return NULL;
-    else{
-	node *n;
-	void *p;
+static void *
+ll_node_key(linked_list *ll, node *n){
+    if (ll->key_offset != 0)
+	return LL_KEY_CACHE(ll, n)->key;
 
-	n = ll->head;
-	ll->head = ll->head->next;
-	ll->node_count--;
+    return ll_data_key(ll, n->data);
+}
 
-	/* clean up */
-	p = n->data;
-	n->next = NULL;
-	n->data = NULL;
-	free(n);
+/* Key to look up, with its prefix computed only once */
+typedef struct ll_probe {
+    void *key;
+    uint64_t prefix;
+} ll_probe;
+
+static void
+ll_make_probe(linked_list *ll, void *key, ll_probe *probe){
+    probe->key = key;
+    probe->prefix = ll->attr.key_prefix_cb == NULL ? 0 :
+	ll->attr.key_prefix_cb(key, ll->keys_compare_metadata);
+}
 
-	return p;
+/* Compare the key of 'n' with the probe. Check the prefixes first */
+static int
+ll_compare_node_key(linked_list *ll, node *n, const ll_probe *probe){
+    if (ll->attr.key_prefix_cb != NULL){
+	uint64_t prefix = LL_KEY_CACHE(ll, n)->prefix;
+
+	if (prefix != probe->prefix)
+	    return prefix < probe->prefix ? -1 : 1;
     }
+
+    LL_STAT_ADD(ll, key_compare_calls, 1);
+
+    return ll->key_compare_cb(ll_node_key(ll, n), probe->key,
+			      ll->keys_compare_metadata);
 }
 
-void *
-ll_ref_index_data(linked_list *ll, int index){
-    node *n;
-    int iter;
+static int
+ll_compare_nodes(linked_list *ll, node *n1, node *n2){
+    if (ll->attr.key_prefix_cb != NULL){
+	uint64_t prefix1 = LL_KEY_CACHE(ll, n1)->prefix,
+	    prefix2 = LL_KEY_CACHE(ll, n2)->prefix;
 
-    if (ll == NULL || ll->head == NULL ||
-	index < 0 || ll_get_length(ll) < index){
-	return NULL;
+	if (prefix1 != prefix2)
+	    return prefix1 < prefix2 ? -1 : 1;
     }
 
-    n = ll->head;
-    for (iter = 0; iter < ll_get_length(ll); iter++){
-	if (iter == index)
-	    return n->data;
+    LL_STAT_ADD(ll, key_compare_calls, 1);
+
+    return ll->key_compare_cb(ll_node_key(ll, n1), ll_node_key(ll, n2),
+			      ll->keys_compare_metadata);
+}
+
+/*
+ * Software prefetching for the scans.
+ *
+ * A scan keeps a second pointer 'ahead', prefetch_distance nodes
+ * in front of the visited node. Each step prefetches what the
+ * comparison of the node at 'ahead' will read (the data, or the
+ * cached key), and the node after it. The links still have to
+ * be followed one by one, but the misses on the data overlap
+ * with the comparisons of the preceding nodes.
+ */
+static void
+ll_prefetch_key(linked_list *ll, node *n){
+    __builtin_prefetch(ll->key_offset != 0 ?
+		       LL_KEY_CACHE(ll, n)->key : n->data);
+}
+
+/* Prefetch the first nodes from 'n' and return the node to prefetch next */
+static node *
+ll_prefetch_start(linked_list *ll, node *n){
+    unsigned int i;
+
+    for (i = 0; i < ll->attr.prefetch_distance && n != NULL; i++){
+	ll_prefetch_key(ll, n);
 	n = n->next;
     }
 
-    assert(0);
+    return ll->attr.prefetch_distance == 0 ? NULL : n;
+}
+
+/* Called once per visited node. Just a branch without prefetching */
+static node *
+ll_prefetch_step(linked_list *ll, node *ahead){
+    if (ahead == NULL)
+	return NULL;
+
+    ll_prefetch_key(ll, ahead);
+    __builtin_prefetch(ahead->next);
+
+    return ahead->next;
+}
+
+/* Can the key operations descend the tower ? */
+static bool
+ll_use_skip_index(linked_list *ll){
+    return ll->skip != NULL && ll->keys_sorted &&
+	ll->key_compare_cb != NULL;
+}
+
+/*
+ * Find where 'key' belongs in the sorted list by descending
+ * the tower.
+ *
+ * Set 'prev' to the last node whose key is smaller than 'key'
+ * (or equal to or smaller than 'key', if 'upper' is true) and
+ * return the number of nodes up to 'prev'. 'prev' is NULL and
+ * the return value is 0 when there is no such node.
+ */
+static uintptr_t
+ll_skip_find_key(linked_list *ll, const ll_probe *key, bool upper,
+		 node **prev){
+    ll_tower *x = ll->skip->header;
+    node *n, *next;
+    uintptr_t pos = 0, visited = 0;
+    int l, cmp;
+
+    for (l = ll->skip->level - 1; l >= 0; l--){
+	while(x->level[l].next != NULL){
+	    visited++;
+	    cmp = ll_compare_node_key(ll, x->level[l].next->node, key);
+	    if (cmp > 0 || (cmp == 0 && !upper))
+		break;
+	    pos += x->level[l].width;
+	    x = x->level[l].next;
+	}
+    }
+
+    /* Walk the nodes between the towers of the lowest level */
+    n = x->node;
+    next = n == NULL ? ll->head : n->next;
+    while(next != NULL){
+	visited++;
+	cmp = ll_compare_node_key(ll, next, key);
+	if (cmp > 0 || (cmp == 0 && !upper))
+	    break;
+	n = next;
+	next = next->next;
+	pos++;
+    }
+    LL_STAT_SCAN(ll, visited);
+
+    *prev = n;
+
+    return pos;
+}
+
+/* Return the first node whose key equals to 'key', if any */
+static node *
+ll_skip_search(linked_list *ll, const ll_probe *key, node **prev,
+	       uintptr_t *index){
+    node *n;
+
+    *index = ll_skip_find_key(ll, key, false, prev);
+    n = *prev == NULL ? ll->head : (*prev)->next;
+    if (n != NULL && ll_compare_node_key(ll, n, key) == 0)
+	return n;
+
+    return NULL;
+}
+
+/*
+ * With the tower, resume from the finger only when the target
+ * is this close. Otherwise, descending the tower is cheaper.
+ */
+#define LL_FINGER_MAX_WALK 16
+
+/*
+ * Return the node at 'index'.
+ *
+ * Walk from the node returned last time (the finger) when the
+ * target is at or after it. With the tower, descend it to the
+ * nearest tower and walk only the rest.
+ */
+static node *
+ll_node_at(linked_list *ll, uintptr_t index){
+    node *n = ll->head;
+    uintptr_t steps = index, visited = 0;
+
+    assert(index < ll->node_count);
+
+    if (index == ll->node_count - 1)
+	return ll->tail;
+
+    if (ll->finger != NULL && ll->finger_index <= index &&
+	(ll->skip == NULL ||
+	 index - ll->finger_index <= LL_FINGER_MAX_WALK)){
+	/* Resume from the last resolved position */
+	n = ll->finger;
+	steps = index - ll->finger_index;
+    }else if (ll->skip != NULL){
+	ll_tower *x = ll->skip->header;
+	uintptr_t x_pos = 0, pos = index + 1;
+	int l;
+
+	for (l = ll->skip->level - 1; l >= 0; l--){
+	    while(x->level[l].next != NULL &&
+		  x_pos + x->level[l].width <= pos){
+		x_pos += x->level[l].width;
+		x = x->level[l].next;
+		visited++;
+	    }
+	}
+
+	if (x->node != NULL){
+	    n = x->node;
+	    steps = pos - x_pos;
+	}
+    }
+
+    visited += steps;
+    while(steps-- > 0)
+	n = n->next;
+    LL_STAT_SCAN(ll, visited);
+
+    ll->finger = n;
+    ll->finger_index = index;
+
+    return n;
+}
+
+/*
+ * Hash table from keys to nodes.
+ *
+ * Open addressing with linear probing. Each entry also keeps
+ * the hash value so that most mismatches don't need to call
+ * key_compare_cb.
+ */
+#define LL_HASH_MIN_CAPACITY 16
+
+typedef struct ll_hash_entry {
+    node *node;
+    uint64_t hash;
+} ll_hash_entry;
+
+typedef struct ll_hash_index {
+    ll_hash_entry *entries;
+
+    /* Always power of two */
+    uintptr_t capacity;
+    uintptr_t used;
+} ll_hash_index;
+
+static ll_hash_entry *
+ll_hash_alloc_entries(uintptr_t capacity){
+    ll_hash_entry *entries;
+
+    if ((entries = (ll_hash_entry *) calloc(capacity,
+					    sizeof(ll_hash_entry))) == NULL){
+	perror("calloc");
+	exit(-1);
+    }
+
+    return entries;
+}
+
+static ll_hash_index *
+ll_hash_create(void){
+    ll_hash_index *hash;
+
+    if ((hash = (ll_hash_index *) malloc(sizeof(ll_hash_index))) == NULL){
+	perror("malloc");
+	exit(-1);
+    }
+
+    hash->capacity = LL_HASH_MIN_CAPACITY;
+    hash->entries = ll_hash_alloc_entries(hash->capacity);
+    hash->used = 0;
+
+    return hash;
+}
+
+static void
+ll_hash_destroy(ll_hash_index *hash){
+    free(hash->entries);
+    free(hash);
+}
+
+static void
+ll_hash_clear(ll_hash_index *hash){
+    memset(hash->entries, 0, hash->capacity * sizeof(ll_hash_entry));
+    hash->used = 0;
+}
+
+/*
+ * Hash 'key' by the callback. Mix the bits further, so that
+ * a simple callback such as an identity function works well.
+ */
+static uint64_t
+ll_hash_key(linked_list *ll, void *key){
+    uint64_t h = ll->attr.key_hash_cb(key, ll->keys_compare_metadata);
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+static void
+ll_hash_put_entry(ll_hash_index *hash, node *n, uint64_t h){
+    uintptr_t mask = hash->capacity - 1, i;
+
+    for (i = h & mask; hash->entries[i].node != NULL; i = (i + 1) & mask)
+	;
+    hash->entries[i].node = n;
+    hash->entries[i].hash = h;
+    hash->used++;
+}
+
+static void
+ll_hash_grow(ll_hash_index *hash){
+    ll_hash_entry *old = hash->entries;
+    uintptr_t old_capacity = hash->capacity, i;
+
+    hash->capacity *= 2;
+    hash->entries = ll_hash_alloc_entries(hash->capacity);
+    hash->used = 0;
+
+    for (i = 0; i < old_capacity; i++)
+	if (old[i].node != NULL)
+	    ll_hash_put_entry(hash, old[i].node, old[i].hash);
+
+    free(old);
+}
+
+static void
+ll_hash_add(linked_list *ll, node *n){
+    ll_hash_index *hash = ll->hash;
+
+    /* Keep the load factor equal to or lower than 3/4 */
+    if ((hash->used + 1) * 4 > hash->capacity * 3)
+	ll_hash_grow(hash);
+
+    ll_hash_put_entry(hash, n, ll_hash_key(ll, ll_node_key(ll, n)));
+}
+
+static void
+ll_hash_delete(linked_list *ll, node *n){
+    ll_hash_index *hash = ll->hash;
+    uintptr_t mask = hash->capacity - 1, i, j, home;
+
+    i = ll_hash_key(ll, ll_node_key(ll, n)) & mask;
+    while(hash->entries[i].node != n){
+	assert(hash->entries[i].node != NULL);
+	i = (i + 1) & mask;
+    }
+
+    /*
+     * Shift the following entries back so that no probe
+     * sequence gets broken by the new hole.
+     */
+    j = i;
+    while(true){
+	j = (j + 1) & mask;
+	if (hash->entries[j].node == NULL)
+	    break;
+
+	home = hash->entries[j].hash & mask;
+	if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+	    continue;
+
+	hash->entries[i] = hash->entries[j];
+	i = j;
+    }
+
+    hash->entries[i].node = NULL;
+    hash->used--;
+}
+
+static node *
+ll_hash_lookup(linked_list *ll, const ll_probe *key){
+    ll_hash_index *hash = ll->hash;
+    uintptr_t mask = hash->capacity - 1, i, visited = 0;
+    uint64_t h = ll_hash_key(ll, key->key);
+    node *n = NULL;
+
+    for (i = h & mask; hash->entries[i].node != NULL; i = (i + 1) & mask){
+	visited++;
+	if (hash->entries[i].hash == h &&
+	    ll_compare_node_key(ll, hash->entries[i].node, key) == 0){
+	    n = hash->entries[i].node;
+	    break;
+	}
+    }
+    LL_STAT_SCAN(ll, visited);
+
+    return n;
+}
+
+static void
+ll_hash_rebuild(linked_list *ll){
+    node *n;
+
+    ll_hash_clear(ll->hash);
+    for (n = ll->head; n != NULL; n = n->next)
+	ll_hash_add(ll, n);
+    LL_STAT_SCAN(ll, ll->node_count);
+}
+
+/*
+ * Find the first node whose key equals to 'key'.
+ *
+ * When 'prev' is given, set it to the previous node of the
+ * hit node and 'index' to the position of the hit node. The
+ * position is LL_UNKNOWN_INDEX when the hash table finds the
+ * node and there is no tower.
+ */
+static node *
+ll_find_node(linked_list *ll, void *key, node **prev, uintptr_t *index){
+    node *n, *p = NULL, *ahead;
+    uintptr_t i = 0;
+    ll_probe probe;
+
+    ll_make_probe(ll, key, &probe);
+
+    /* The tower tells the position, which the hash table doesn't */
+    if (ll->hash != NULL && (prev == NULL || !ll_use_skip_index(ll))){
+	if ((n = ll_hash_lookup(ll, &probe)) == NULL)
+	    return NULL;
+
+	if (prev != NULL){
+	    *prev = LL_PREV(n);
+	    /* Only the tower needs the position of the node */
+	    if (ll->skip != NULL){
+		for (p = ll->head; p != n; p = p->next)
+		    i++;
+		LL_STAT_SCAN(ll, i);
+		*index = i;
+	    }else{
+		*index = LL_UNKNOWN_INDEX;
+	    }
+	}
+
+	return n;
+    }
+
+    if (ll_use_skip_index(ll)){
+	n = ll_skip_search(ll, &probe, &p, &i);
+    }else{
+	ahead = ll_prefetch_start(ll, ll->head);
+	for (n = ll->head; n != NULL; n = n->next){
+	    ahead = ll_prefetch_step(ll, ahead);
+	    if (ll_compare_node_key(ll, n, &probe) == 0)
+		break;
+	    p = n;
+	    i++;
+	}
+	LL_STAT_SCAN(ll, n == NULL ? i : i + 1);
+    }
+
+    if (n != NULL && prev != NULL){
+	*prev = p;
+	*index = i;
+    }
+
+    return n;
+}
+
+/* Forget all nodes in the indexes. Used when the list gets empty */
+static void
+ll_clear_indexes(linked_list *ll){
+    ll->generation++;
+    ll->finger = NULL;
+    if (ll->skip != NULL)
+	ll_skip_clear(ll->skip, 0);
+    if (ll->hash != NULL)
+	ll_hash_clear(ll->hash);
+    ll->keys_sorted = true;
+}
+
+/* Index all nodes again, after the nodes are relinked in bulk */
+static void
+ll_rebuild_indexes(linked_list *ll){
+    ll->generation++;
+    ll->finger = NULL;
+    if (ll->skip != NULL)
+	ll_skip_rebuild(ll);
+    if (ll->hash != NULL)
+	ll_hash_rebuild(ll);
+}
+
+/*
+ * Connect 'n' just after 'prev'. When 'prev' is NULL,
+ * 'n' becomes the new head. 'index' is the position of
+ * 'n' after the connection.
+ */
+static void
+ll_link_node(linked_list *ll, node *prev, node *n, uintptr_t index){
+    node *next = prev == NULL ? ll->head : prev->next;
+
+    ll->generation++;
+
+    if (ll->skip != NULL){
+	/* Does the new node keep the ascending order ? */
+	if (ll->keys_sorted && ll->key_compare_cb != NULL){
+	    if ((prev != NULL && ll_compare_nodes(ll, prev, n) > 0) ||
+		(next != NULL && ll_compare_nodes(ll, next, n) < 0))
+		ll->keys_sorted = false;
+	}
+	ll_skip_insert(ll, index + 1, n);
+    }
+
+    n->next = next;
+    if (prev == NULL)
+	ll->head = n;
+    else
+	prev->next = n;
+
+    if (next == NULL)
+	ll->tail = n;
+
+    if (ll->attr.doubly_linked){
+	LL_PREV(n) = prev;
+	if (next != NULL)
+	    LL_PREV(next) = n;
+    }
+
+    if (ll->hash != NULL)
+	ll_hash_add(ll, n);
+
+    /* The finger gets shifted by the new node */
+    if (ll->finger != NULL && index <= ll->finger_index)
+	ll->finger_index++;
+
+    ll->node_count++;
+}
+
+/*
+ * Disconnect 'n' whose previous node is 'prev' (NULL
+ * when 'n' is the head) and whose position is 'index'
+ * from the list. 'index' can be LL_UNKNOWN_INDEX when
+ * the list has no tower.
+ */
+static void
+ll_unlink_node(linked_list *ll, node *prev, node *n, uintptr_t index){
+    assert(prev == NULL ? ll->head == n : prev->next == n);
+
+    ll->generation++;
+
+    if (ll->skip != NULL){
+	assert(index != LL_UNKNOWN_INDEX);
+	ll_skip_remove(ll, index + 1);
+    }
+
+    if (ll->finger != NULL){
+	if (index == LL_UNKNOWN_INDEX){
+	    /* Can't tell if the finger gets shifted */
+	    ll->finger = NULL;
+	}else if (index < ll->finger_index){
+	    ll->finger_index--;
+	}else if (index == ll->finger_index){
+	    /* Step back, so that removals in a row stay close */
+	    ll->finger = prev;
+	    ll->finger_index = index - 1;
+	}
+    }
+
+    if (ll->hash != NULL)
+	ll_hash_delete(ll, n);
+
+    if (prev == NULL)
+	ll->head = n->next;
+    else
+	prev->next = n->next;
+
+    if (n->next == NULL)
+	ll->tail = prev;
+    else if (ll->attr.doubly_linked)
+	LL_PREV(n->next) = prev;
+
+    n->next = NULL;
+
+    /* An empty list is sorted */
+    if (--ll->node_count == 0)
+	ll->keys_sorted = true;
+}
+
+linked_list *
+ll_init(void *(*key_access_cb)(void *data),
+	int (*key_compare_cb)(void *key1,
+			      void *key2,
+			      void *key_compare_metadata),
+	void (*free_cb)(void *data),
+	void *keys_compare_metadata){
+    return ll_init_with_attr(key_access_cb, key_compare_cb,
+			     free_cb, keys_compare_metadata, NULL);
+}
+
+linked_list *
+ll_init_with_attr(void *(*key_access_cb)(void *data),
+		  int (*key_compare_cb)(void *key1,
+					void *key2,
+					void *key_compare_metadata),
+		  void (*free_cb)(void *data),
+		  void *keys_compare_metadata,
+		  const ll_attr *attr){
+    linked_list *new_ll;
+
+    if ((new_ll = (linked_list *) malloc(sizeof(linked_list))) == NULL){
+	perror("malloc");
+	exit(-1);
+    }
+
+    new_ll->node_count = 0;
+    new_ll->head = new_ll->tail = NULL;
+
+    /* Positional access cache */
+    new_ll->finger = NULL;
+    new_ll->finger_index = 0;
+
+    /* Set callbacks */
+    new_ll->key_access_cb = key_access_cb;
+    new_ll->key_compare_cb = key_compare_cb;
+    new_ll->free_cb = free_cb;
+
+    /* Iteration control */
+    new_ll->current_node = NULL;
+    new_ll->iter_in_progress = false;
+
+    /* Set metadata for advanced keys comparsion */
+    new_ll->keys_compare_metadata = keys_compare_metadata;
+
+    /* Optional settings */
+    if (attr != NULL)
+	new_ll->attr = *attr;
+    else
+	memset(&new_ll->attr, 0, sizeof(ll_attr));
+
+    /* A node hit by the hash table is removed without walk */
+    if (new_ll->attr.key_hash_cb != NULL)
+	new_ll->attr.doubly_linked = true;
+
+    if (new_ll->attr.prefetch_distance == 0)
+	new_ll->attr.prefetch_distance = LL_PREFETCH_DISTANCE;
+    if (new_ll->attr.prefetch_distance > LL_PREFETCH_MAX_DISTANCE)
+	new_ll->attr.prefetch_distance = LL_PREFETCH_MAX_DISTANCE;
+
+    /* Comparing the prefixes needs them in the nodes */
+    if (new_ll->attr.key_prefix_cb != NULL)
+	new_ll->attr.cache_keys = true;
+
+    new_ll->node_size = new_ll->attr.doubly_linked ?
+	sizeof(ext_node) : sizeof(node);
+
+    /* Cached key follows the links */
+    if (new_ll->attr.cache_keys){
+	new_ll->key_offset = new_ll->node_size;
+	new_ll->node_size += new_ll->attr.key_prefix_cb != NULL ?
+	    sizeof(ll_key_cache) : offsetof(ll_key_cache, prefix);
+    }else{
+	new_ll->key_offset = 0;
+    }
+
+    /* Node allocator */
+    if (new_ll->attr.nodes_per_slab > 0)
+	new_ll->pool = ll_pool_create(new_ll->attr.nodes_per_slab,
+				      new_ll->node_size);
+    else
+	new_ll->pool = NULL;
+
+    /* Skip-list tower */
+    if (new_ll->attr.skip_index)
+	new_ll->skip = ll_skip_create();
+    else
+	new_ll->skip = NULL;
+    new_ll->keys_sorted = true;
+
+    /* Parallel scans */
+    new_ll->generation = 0;
+    new_ll->partition = NULL;
+
+    memset(&new_ll->stats, 0, sizeof(ll_stats));
+
+    /* Latency histograms of the traced operations */
+    if (new_ll->attr.latency_histograms){
+	if ((new_ll->latency = (ll_latency *) calloc(LL_OP_COUNT,
+						     sizeof(ll_latency))) == NULL){
+	    perror("calloc");
+	    exit(-1);
+	}
+    }else{
+	new_ll->latency = NULL;
+    }
+
+    /* Hash table of keys */
+    if (new_ll->attr.key_hash_cb != NULL)
+	new_ll->hash = ll_hash_create();
+    else
+	new_ll->hash = NULL;
+
+    return new_ll;
+}
+
+/*
+ * Create an empty list with the same callbacks and settings
+ * as 'll'. The new list shares the node allocator of 'll',
+ * so that nodes can be moved between the two lists.
+ */
+static linked_list *
+ll_init_like(linked_list *ll){
+    linked_list *new_ll;
+    ll_attr attr = ll->attr;
+
+    attr.nodes_per_slab = 0;
+    new_ll = ll_init_with_attr(ll->key_access_cb,
+			       ll->key_compare_cb,
+			       ll->free_cb,
+			       ll->keys_compare_metadata,
+			       &attr);
+    new_ll->attr = ll->attr;
+    if ((new_ll->pool = ll->pool) != NULL)
+	new_ll->pool->refcount++;
+
+    return new_ll;
+}
+
+bool
+ll_is_empty(linked_list *ll){
+    assert(ll != NULL);
+	
+    if (ll->node_count == 0)
+	return true;
+    else
+	return false;
+}
+
+int
+ll_get_length(linked_list *ll){
+    return ll->node_count;
+}
+
+void
+ll_insert(linked_list *ll, void *data){
+    if (!ll)
+	return;
+
+    ll_link_node(ll, NULL, ll_gen_node(ll, data), 0);
+}
+
+void
+ll_tail_insert(linked_list *ll, void *data){
+    if (!ll)
+	return;
+
+    /* Connect after the last node without any walk */
+    ll_link_node(ll, ll->tail, ll_gen_node(ll, data),
+		 ll->node_count);
+}
+
+void *
+ll_remove_first_data(linked_list *ll){
+    if (ll == NULL || ll->head == NULL)
+	return NULL;
+    else{
+	node *n;
+	void *p;
+
+	n = ll->head;
+	ll_unlink_node(ll, NULL, n, 0);
+
+	/* clean up */
+	p = n->data;
+	n->data = NULL;
+	ll_free_node(ll, n);
+
+	return p;
+    }
+}
+
+void *
+ll_ref_index_data(linked_list *ll, int index){
+    if (ll == NULL || ll->head == NULL ||
+	index < 0 || ll_get_length(ll) <= index){
+	return NULL;
+    }
+
+    return ll_node_at(ll, index)->data;
+}
+
+/*
+ * Return the number of nodes whose keys are smaller than
+ * 'key'. For a list in ascending order, this is the index
+ * of the first node with 'key' if the key exists.
+ *
+ * Return -1 on failure.
+ */
+int
+ll_rank(linked_list *ll, void *key){
+    node *n, *ahead;
+    ll_probe probe;
+    int rank = 0;
+
+    if (ll == NULL || ll->key_compare_cb == NULL)
+	return -1;
+
+    ll_make_probe(ll, key, &probe);
+    if (ll_use_skip_index(ll))
+	return ll_skip_find_key(ll, &probe, false, &n);
+
+    ahead = ll_prefetch_start(ll, ll->head);
+    for (n = ll->head; n != NULL; n = n->next){
+	ahead = ll_prefetch_step(ll, ahead);
+	if (ll_compare_node_key(ll, n, &probe) < 0)
+	    rank++;
+    }
+    LL_STAT_SCAN(ll, ll->node_count);
+
+    return rank;
+}
+
+/* Don't remove the hit node from the list */
+static void *
+ll_do_search_by_key(linked_list *ll, void *key){
+    node *n;
+
+    if (!ll || !ll->head || !key || !ll->key_compare_cb)
+	return NULL;
+
+    if ((n = ll_find_node(ll, key, NULL, NULL)) == NULL)
+	return NULL;
+
+    return n->data;
+}
+
+void *
+ll_search_by_key(linked_list *ll, void *key){
+    ll_trace_point tp;
+    void *data;
+
+    if (!ll_trace_begin(ll, &tp))
+	return ll_do_search_by_key(ll, key);
+
+    data = ll_do_search_by_key(ll, key);
+    ll_trace_end(ll, LL_OP_SEARCH_BY_KEY, &tp);
+
+    return data;
+}
+
+static void *
+ll_do_remove_by_key(linked_list *ll, void *key){
+    node *prev, *cur;
+    void *p;
+    uintptr_t index;
+
+    if (!ll || !key || !ll->head || !ll->key_compare_cb)
+	return NULL;
+
+    if ((cur = ll_find_node(ll, key, &prev, &index)) == NULL)
+	return NULL;
+
+    ll_unlink_node(ll, prev, cur, index);
+    p = cur->data;
+    ll_free_node(ll, cur);
+
+    return p;
+}
+
+void *
+ll_remove_by_key(linked_list *ll, void *key){
+    ll_trace_point tp;
+    void *data;
+
+    if (!ll_trace_begin(ll, &tp))
+	return ll_do_remove_by_key(ll, key);
+
+    data = ll_do_remove_by_key(ll, key);
+    ll_trace_end(ll, LL_OP_REMOVE_BY_KEY, &tp);
+
+    return data;
+}
+
+void *
+ll_replace_by_key(linked_list *ll, void *old_key, void *new_data){
+    node *curr, *prev = NULL;
+    uintptr_t index;
+    bool check_order;
+    void *tmp;
+
+    if (ll == NULL || ll->head == NULL)
+	return NULL;
+
+    /* The tower finds the previous node too, while the order holds */
+    check_order = ll->skip != NULL && ll->keys_sorted &&
+	ll->key_compare_cb != NULL;
+    if ((curr = ll_find_node(ll, old_key, check_order ? &prev : NULL,
+			     check_order ? &index : NULL)) == NULL)
+	return NULL;
+
+    if (ll->hash != NULL)
+	ll_hash_delete(ll, curr);
+
+    tmp = curr->data;
+    curr->data = new_data;
+    if (ll->key_offset != 0)
+	ll_cache_key(ll, curr);
+
+    if (ll->hash != NULL)
+	ll_hash_add(ll, curr);
+
+    /* Does the new key still sit between the neighbors ? */
+    if (check_order){
+	if ((prev != NULL && ll_compare_nodes(ll, prev, curr) > 0) ||
+	    (curr->next != NULL && ll_compare_nodes(ll, curr->next, curr) < 0))
+	    ll->keys_sorted = false;
+    }
+
+    return tmp;
+}
+
+
+void *
+ll_tail_remove(linked_list *ll){
+    node *prev, *curr;
+    void *data;
+
+    if (ll == NULL || ll->head == NULL)
+	return NULL;
+
+    curr = ll->tail;
+
+    if (ll->attr.doubly_linked){
+	prev = LL_PREV(curr);
+    }else if (curr == ll->head){
+	prev = NULL;
+    }else{
+	/* Find the second-to-last node */
+	prev = ll_node_at(ll, ll->node_count - 2);
+    }
+
+    ll_unlink_node(ll, prev, curr, ll->node_count - 1);
+    data = curr->data;
+    ll_free_node(ll, curr);
+
+    return data;
+}
+
+/*
+ * Unlink every node whose data gets 'match' from 'pred' in one
+ * pass, and rebuild the indexes once in the end.
+ */
+static int
+ll_remove_matching(linked_list *ll, bool (*pred)(void *data, void *ctx),
+		   void *ctx, bool match, linked_list *removed){
+    node *prev = NULL, *n, *next;
+    int count = 0;
+
+    if (ll == NULL || pred == NULL)
+	return -1;
+
+    assert(removed != ll);
+
+    for (n = ll->head; n != NULL; n = next){
+	next = n->next;
+
+	if (pred(n->data, ctx) != match){
+	    /* Keep it after the last kept node */
+	    if (prev == NULL)
+		ll->head = n;
+	    else
+		prev->next = n;
+	    if (ll->attr.doubly_linked)
+		LL_PREV(n) = prev;
+	    prev = n;
+	    continue;
+	}
+
+	if (removed != NULL)
+	    ll_tail_insert(removed, n->data);
+	else if (ll->free_cb && n->data)
+	    ll->free_cb(n->data);
+	ll_free_node(ll, n);
+	count++;
+    }
+
+    if (prev == NULL)
+	ll->head = NULL;
+    else
+	prev->next = NULL;
+    ll->tail = prev;
+    LL_STAT_SCAN(ll, ll->node_count);
+    ll->node_count -= count;
+
+    if (count > 0){
+	/* Removals keep the order */
+	if (ll->head == NULL)
+	    ll->keys_sorted = true;
+	ll_rebuild_indexes(ll);
+    }
+
+    return count;
+}
+
+/*
+ * Remove all data for which 'pred' returns true, in one pass,
+ * and return the number of them.
+ *
+ * When 'removed' is given, the removed data is appended to it
+ * in the list order. Otherwise, free_cb is called for them.
+ * Return -1 on failure.
+ */
+int
+ll_remove_if(linked_list *ll, bool (*pred)(void *data, void *ctx),
+	     void *ctx, linked_list *removed){
+    return ll_remove_matching(ll, pred, ctx, true, removed);
+}
+
+/* Same as ll_remove_if(), but keep the data for which 'pred' returns true */
+int
+ll_retain_if(linked_list *ll, bool (*pred)(void *data, void *ctx),
+	     void *ctx, linked_list *removed){
+    return ll_remove_matching(ll, pred, ctx, false, removed);
+}
+
+void
+ll_remove_all(linked_list *ll){
+    node *curr, *next;
+    bool release_slabs;
+
+    if (ll == NULL)
+	return;
+
+    /*
+     * When the pool isn't shared, all of its nodes belong to
+     * this list. Then, release the slabs at once and visit
+     * the nodes only to free the application data.
+     */
+    release_slabs = ll->pool != NULL && ll->pool->refcount == 1;
+    if (release_slabs)
+	assert(ll->pool->nodes_in_use == ll->node_count);
+
+    if (!release_slabs || ll->free_cb){
+	for (curr = ll->head; curr != NULL; curr = next){
+	    next = curr->next;
+
+	    if (ll->free_cb && curr->data)
+		ll->free_cb(curr->data);
+
+	    if (!release_slabs)
+		ll_free_node(ll, curr);
+	}
+	LL_STAT_SCAN(ll, ll->node_count);
+    }
+
+    if (release_slabs){
+	ll_pool_release_slabs(ll->pool);
+	LL_STAT_ADD(ll, node_frees, ll->node_count);
+    }
+
+    ll->head = ll->tail = NULL;
+    ll->node_count = 0;
+
+    ll_clear_indexes(ll);
+}
+
+/*
+ * Move the first 'no_nodes' nodes to a new list, relinking
+ * the existing nodes.
+ */
+static linked_list *
+ll_do_split(linked_list *ll, int no_nodes){
+    linked_list *new_list;
+    node *last;
+    int i;
+
+    if (ll_get_length(ll) < no_nodes){
+	return ll;
+    }else if (no_nodes <= 0){
+	return ll;
+    }
+
+    new_list = ll_init_like(ll);
+
+    /* Find the last node to move */
+    last = ll->head;
+    for (i = 1; i < no_nodes; i++)
+	last = last->next;
+    LL_STAT_SCAN(ll, no_nodes);
+
+    new_list->head = ll->head;
+    new_list->tail = last;
+    new_list->node_count = no_nodes;
+
+    ll->head = last->next;
+    ll->node_count -= no_nodes;
+    if (ll->head == NULL)
+	ll->tail = NULL;
+    else if (ll->attr.doubly_linked)
+	LL_PREV(ll->head) = NULL;
+    last->next = NULL;
+
+    /* Both parts keep the order of the original list */
+    new_list->keys_sorted = ll->keys_sorted;
+    ll_rebuild_indexes(ll);
+    ll_rebuild_indexes(new_list);
+
+    return new_list;
+}
+
+linked_list *
+ll_split(linked_list *ll, int no_nodes){
+    ll_trace_point tp;
+    linked_list *first;
+
+    if (!ll_trace_begin(ll, &tp))
+	return ll_do_split(ll, no_nodes);
+
+    first = ll_do_split(ll, no_nodes);
+    ll_trace_end(ll, LL_OP_SPLIT, &tp);
+
+    return first;
+}
+
+/*
+ * Detach the head of 'll' by relinking only. The indexes of 'll'
+ * must have been cleared.
+ */
+static node *
+ll_pop_head(linked_list *ll){
+    node *n = ll->head;
+
+    if ((ll->head = n->next) == NULL)
+	ll->tail = NULL;
+    else if (ll->attr.doubly_linked)
+	LL_PREV(ll->head) = NULL;
+    n->next = NULL;
+    ll->node_count--;
+
+    return n;
+}
+
+/*
+ * Connect 'n' after the tail of 'll' by relinking only. The
+ * indexes of 'll' are left to ll_rebuild_indexes().
+ */
+static void
+ll_append_node(linked_list *ll, node *n){
+    n->next = NULL;
+    if (ll->attr.doubly_linked)
+	LL_PREV(n) = ll->tail;
+    if (ll->tail == NULL)
+	ll->head = n;
+    else
+	ll->tail->next = n;
+    ll->tail = n;
+    ll->node_count++;
+}
+
+/*
+ * Append the first node of 'from' to the end of 'to'. Neither
+ * list may have indexes to maintain meanwhile.
+ *
+ * The node itself is relinked when both lists share the
+ * node allocator. Otherwise, the data is moved to a node
+ * of the allocator of 'to'.
+ */
+static void
+ll_move_first_node(linked_list *from, linked_list *to){
+    node *n = ll_pop_head(from);
+
+    if (from->pool != to->pool){
+	node *moved = ll_gen_node(to, n->data);
+
+	ll_free_node(from, n);
+	n = moved;
+    }
+
+    ll_append_node(to, n);
+}
+
+/*
+ * Append all nodes of 'from' to the end of 'to', under the same
+ * condition as ll_move_first_node().
+ */
+static void
+ll_move_all_nodes(linked_list *from, linked_list *to){
+    if (from->head == NULL)
+	return;
+
+    if (from->pool != to->pool){
+	while(from->head != NULL)
+	    ll_move_first_node(from, to);
+	return;
+    }
+
+    /* Connect the whole chain at once */
+    if (to->tail == NULL)
+	to->head = from->head;
+    else{
+	to->tail->next = from->head;
+	if (to->attr.doubly_linked)
+	    LL_PREV(from->head) = to->tail;
+    }
+    to->tail = from->tail;
+    to->node_count += from->node_count;
+
+    from->head = from->tail = NULL;
+    from->node_count = 0;
+}
+
+/*
+ * If either list is empty, move the left keys to the
+ * newly created linked list. In any case, drain both
+ * input lists completely.
+ *
+ * The nodes are relinked into the new list, without
+ * allocating or releasing any node, as long as the two
+ * lists share the same node allocator.
+ */
+static linked_list *
+ll_do_merge(linked_list *ll1, linked_list *ll2){
+    linked_list *result;
+    ll_skip_index *skip;
+    ll_hash_index *hash;
+    bool ll1_sorted = ll1->keys_sorted, ll2_sorted = ll2->keys_sorted;
+    uintptr_t visited = ll1->node_count + ll2->node_count;
+
+    /* Are the two lists joinable ? */
+    assert(ll1->key_access_cb == ll2->key_access_cb);
+    assert(ll1->key_compare_cb == ll2->key_compare_cb);
+    assert(ll1->free_cb == ll2->free_cb);
+    assert(ll1->keys_compare_metadata == ll2->keys_compare_metadata);
+    assert(ll1->attr.doubly_linked == ll2->attr.doubly_linked);
+    assert(ll1->attr.skip_index == ll2->attr.skip_index);
+    assert(ll1->attr.key_hash_cb == ll2->attr.key_hash_cb);
+    assert(ll1->attr.cache_keys == ll2->attr.cache_keys);
+    assert(ll1->attr.key_prefix_cb == ll2->attr.key_prefix_cb);
+
+    result = ll_init_like(ll1);
+
+    /*
+     * The nodes are moved by relinking only. Drop the indexes of
+     * the inputs once, and build the ones of the result at once
+     * in the end, rather than maintaining them for every node.
+     */
+    ll_clear_indexes(ll1);
+    ll_clear_indexes(ll2);
+    skip = result->skip;
+    hash = result->hash;
+    result->skip = NULL;
+    result->hash = NULL;
+
+    /* We have two lists with data to merge */
+    while(ll1->head != NULL && ll2->head != NULL){
+	if (ll_compare_nodes(result, ll1->head, ll2->head) <= 0){
+	    /* d1 key < d2 key or those are equal */
+	    ll_move_first_node(ll1, result);
+	}else{
+	    /* d1 key > d2 key */
+	    ll_move_first_node(ll2, result);
+	}
+    }
+
+    /*
+     * Either input list is now empty, but the other one
+     * isn't. Continue to move until the remaining list
+     * becomes empty.
+     */
+    ll_move_all_nodes(ll1, result);
+    ll_move_all_nodes(ll2, result);
+    LL_STAT_SCAN(result, visited);
+
+    assert(ll1->head == NULL);
+    assert(ll2->head == NULL);
+
+    result->skip = skip;
+    result->hash = hash;
+    ll_rebuild_indexes(result);
+
+    /* Merging two sorted lists keeps the order */
+    result->keys_sorted = ll1_sorted && ll2_sorted;
+
+    return result;
+}
+
+/* Traced on 'll1' and recorded in the new list */
+linked_list *
+ll_merge(linked_list *ll1, linked_list *ll2){
+    ll_trace_point tp;
+    linked_list *result;
+
+    if (!ll_trace_begin(ll1, &tp))
+	return ll_do_merge(ll1, ll2);
+
+    result = ll_do_merge(ll1, ll2);
+    /* The new list has counted from zero */
+    tp.visited = 0;
+    ll_trace_end(result, LL_OP_MERGE, &tp);
+
+    return result;
+}
+
+static int
+ll_compare_data(linked_list *ll, void *data1, void *data2){
+    void *key1 = ll_data_key(ll, data1), *key2 = ll_data_key(ll, data2);
+
+    LL_STAT_ADD(ll, key_compare_calls, 1);
+
+    return ll->key_compare_cb(key1, key2, ll->keys_compare_metadata);
+}
+
+/*
+ * Detach the natural run at the beginning of the chain 'head'.
+ *
+ * A run is a sequence of ascending keys. A sequence of strictly
+ * descending keys is reversed and regarded as a run as well,
+ * which doesn't break the stability. Set 'rest' to the chain
+ * after the run and 'len' to the length of the run.
+ */
+static node *
+ll_cut_run(linked_list *ll, node *head, node **rest, uintptr_t *len){
+    node *last = head, *next = head->next;
+
+    *len = 1;
+
+    if (next != NULL && ll_compare_nodes(ll, head, next) > 0){
+	/* Reverse the descending run */
+	head->next = NULL;
+	while(next != NULL && ll_compare_nodes(ll, last, next) > 0){
+	    node *following = next->next;
+
+	    next->next = last;
+	    last = next;
+	    next = following;
+	    (*len)++;
+	}
+	*rest = next;
+	LL_STAT_SCAN(ll, *len);
+
+	return last;
+    }
+
+    while(next != NULL && ll_compare_nodes(ll, last, next) <= 0){
+	last = next;
+	next = next->next;
+	(*len)++;
+    }
+    last->next = NULL;
+    *rest = next;
+    LL_STAT_SCAN(ll, *len);
+
+    return head;
+}
+
+/*
+ * Merge two sorted chains. Take from 'n1' first for equal keys,
+ * so that the merge is stable.
+ */
+static node *
+ll_merge_chains(linked_list *ll, node *n1, node *n2){
+    node head, *last = &head;
+    uintptr_t visited = 0;
+
+    while(n1 != NULL && n2 != NULL){
+	visited++;
+	if (ll_compare_nodes(ll, n1, n2) <= 0){
+	    last->next = n1;
+	    last = n1;
+	    n1 = n1->next;
+	}else{
+	    last->next = n2;
+	    last = n2;
+	    n2 = n2->next;
+	}
+    }
+    last->next = n1 != NULL ? n1 : n2;
+    LL_STAT_SCAN(ll, visited);
+
+    return head.next;
+}
+
+/*
+ * Sort the chain 'head' by the bottom-up natural merge sort
+ * and return the new head.
+ *
+ * The detected runs are pushed to a stack, and the top two runs
+ * get merged while the lower one isn't more than twice as long
+ * as the upper one. This keeps the stack depth logarithmic and
+ * the merges balanced, without any allocation. A chain which
+ * is already sorted makes only one run.
+ */
+static node *
+ll_sort_chain(linked_list *ll, node *head){
+    struct {
+	node *head;
+	uintptr_t len;
+    } runs[64];
+    int depth = 0;
+
+    while(head != NULL){
+	runs[depth].head = ll_cut_run(ll, head, &head, &runs[depth].len);
+	depth++;
+
+	while(depth >= 2 && runs[depth - 2].len <= 2 * runs[depth - 1].len){
+	    runs[depth - 2].head = ll_merge_chains(ll, runs[depth - 2].head,
+						   runs[depth - 1].head);
+	    runs[depth - 2].len += runs[depth - 1].len;
+	    depth--;
+	}
+    }
+
+    while(depth >= 2){
+	runs[depth - 2].head = ll_merge_chains(ll, runs[depth - 2].head,
+					       runs[depth - 1].head);
+	runs[depth - 2].len += runs[depth - 1].len;
+	depth--;
+    }
+
+    return depth == 0 ? NULL : runs[0].head;
+}
+
+/*
+ * Set the tail and the links to previous nodes again, after
+ * the chain from the head got reordered.
+ */
+static void
+ll_fix_links(linked_list *ll){
+    node *prev = NULL, *n;
+
+    for (n = ll->head; n != NULL; n = n->next){
+	if (ll->attr.doubly_linked)
+	    LL_PREV(n) = prev;
+	prev = n;
+    }
+    ll->tail = prev;
+    LL_STAT_SCAN(ll, ll->node_count);
+}
+
+/*
+ * Sort the indexes of 'items' by their keys with the stable
+ * bottom-up merge sort. 'tmp' must be as large as 'order'.
+ * Return the array which holds the result.
+ */
+static size_t *
+ll_sort_item_order(linked_list *ll, void **items, size_t *order,
+		   size_t *tmp, size_t n){
+    size_t width, lo, mid, hi, i, j, k, *swap;
+
+    for (i = 0; i < n; i++)
+	order[i] = i;
+
+    for (width = 1; width < n; width *= 2){
+	for (lo = 0; lo < n; lo += 2 * width){
+	    mid = lo + width < n ? lo + width : n;
+	    hi = mid + width < n ? mid + width : n;
+
+	    for (i = lo, j = mid, k = lo; k < hi; k++){
+		if (j >= hi ||
+		    (i < mid && ll_compare_data(ll, items[order[i]],
+						items[order[j]]) <= 0))
+		    tmp[k] = order[i++];
+		else
+		    tmp[k] = order[j++];
+	    }
+	}
+	swap = order;
+	order = tmp;
+	tmp = swap;
+    }
+
+    return order;
+}
+
+/*
+ * Check the order of the neighbors, unless the tower knows it.
+ * A list found in order gets keys_sorted back.
+ */
+static bool
+ll_keys_ascending(linked_list *ll){
+    node *n;
+    uintptr_t visited = 0;
+    bool sorted = true;
+
+    if (ll->key_compare_cb == NULL)
+	return false;
+
+    if (ll->skip != NULL && ll->keys_sorted)
+	return true;
+
+    for (n = ll->head; n != NULL && n->next != NULL; n = n->next){
+	visited++;
+	if (ll_compare_nodes(ll, n, n->next) > 0){
+	    sorted = false;
+	    break;
+	}
+    }
+    LL_STAT_SCAN(ll, visited);
+
+    if (sorted)
+	ll->keys_sorted = true;
+
+    return sorted;
+}
+
+/*
+ * Insert 'n' items in ascending order at once.
+ *
+ * The items are sorted first, then merged into the list in one
+ * pass. Equal keys are placed in the same order as calling
+ * ll_asc_insert() for each item. When 'positions' is given,
+ * set positions[i] to the index of items[i] after the whole
+ * batch gets inserted.
+ *
+ * The list must be in ascending order, which is checked by one
+ * pass over it unless the skip-list tower knows the order. Return
+ * 0 on success and -1 on failure, leaving the list untouched.
+ */
+int
+ll_asc_insert_batch(linked_list *ll, void **items, size_t n,
+		    int *positions){
+    ll_skip_index *skip;
+    node *prev = NULL, *curr, *new_node;
+    size_t *order, *buf, i;
+    ll_probe probe;
+    uintptr_t pos = 0, visited = 0;
+
+    if (ll == NULL || ll->key_compare_cb == NULL ||
+	(items == NULL && n > 0))
+	return -1;
+
+    /* The merge below doesn't work for a list out of order */
+    if (!ll_keys_ascending(ll))
+	return -1;
+
+    if (n == 0)
+	return 0;
+
+    if ((buf = (size_t *) malloc(2 * n * sizeof(size_t))) == NULL){
+	perror("malloc");
+	exit(-1);
+    }
+    order = ll_sort_item_order(ll, items, buf, buf + n, n);
+
+    /* Carve all new nodes out of one slab */
+    if (ll->pool != NULL)
+	ll_pool_reserve(ll->pool, n);
+
+    /* Build the tower at once in the end */
+    skip = ll->skip;
+    ll->skip = NULL;
+
+    curr = ll->head;
+    for (i = 0; i < n; i++){
+	new_node = ll_gen_node(ll, items[order[i]]);
+	ll_make_probe(ll, ll_node_key(ll, new_node), &probe);
+
+	/* Go beyond the keys equal to or smaller than the item */
+	while(curr != NULL && ll_compare_node_key(ll, curr, &probe) <= 0){
+	    prev = curr;
+	    curr = curr->next;
+	    pos++;
+	    visited++;
+	}
+
+	ll_link_node(ll, prev, new_node, pos);
+	if (positions != NULL)
+	    positions[order[i]] = pos;
+	prev = new_node;
+	pos++;
+    }
+
+    LL_STAT_SCAN(ll, visited);
+
+    if ((ll->skip = skip) != NULL)
+	ll_skip_rebuild(ll);
+
+    free(buf);
+
+    return 0;
+}
+
+/* Make the sorted chain of all nodes the list */
+static void
+ll_set_sorted_chain(linked_list *ll, node *head){
+    ll->head = head;
+    ll_fix_links(ll);
+
+    /* The hash table doesn't care about the order */
+    ll->generation++;
+    ll->finger = NULL;
+    if (ll->skip != NULL)
+	ll_skip_rebuild(ll);
+    ll->keys_sorted = true;
+}
+
+/*
+ * Sort the list in ascending order of keys, relinking the
+ * existing nodes. The sort is stable and costs O(n) for a
+ * list which is already (or nearly) sorted.
+ */
+void
+ll_sort(linked_list *ll){
+    if (ll == NULL || ll->head == NULL || ll->key_compare_cb == NULL)
+	return;
+
+    ll_set_sorted_chain(ll, ll_sort_chain(ll, ll->head));
+}
+
+void
+ll_begin_iter(linked_list *ll){
+    assert(ll->iter_in_progress == false);
+    assert(ll->current_node == NULL);
+
+    ll->iter_in_progress = true;
+    /* Set the node which will be referenced next */
+    ll->current_node = ll->head;
+}
+
+void *
+ll_get_iter_data(linked_list *ll){
+    node *n;
+
+    assert(ll->iter_in_progress == true);
+
+    n = ll->current_node;
+
+    /* If the current node is null, then return null */
+    if (n == NULL)
+	return NULL;
+    else{
+	/* Shift the node to the next one for the next call */
+	ll->current_node = ll->current_node->next;
+	return n->data;
+    }
+}
+
+void
+ll_end_iter(linked_list *ll){
+    assert(ll->iter_in_progress == true);
+
+    ll->iter_in_progress = false;
+    ll->current_node = NULL;
+}
+
+/*
+ * The parallel scans split the list into at most this number of
+ * segments, so that threads which finish early take more.
+ */
+#define LL_MAX_SEGMENTS 64
+
+/* Below this number of nodes per thread, one thread scans all */
+#define LL_PARALLEL_MIN_NODES 4096
+
+typedef struct ll_partition {
+    /* Generation of the list when the segments were sampled */
+    uint64_t generation;
+    unsigned int segment_count;
+    node *starts[LL_MAX_SEGMENTS];
+    uintptr_t lengths[LL_MAX_SEGMENTS];
+} ll_partition;
+
+/* Sample the segments again if the list has changed since last time */
+static ll_partition *
+ll_prepare_partition(linked_list *ll){
+    ll_partition *part = ll->partition;
+    uintptr_t step, extra, index = 0, i;
+    unsigned int s;
+    node *n;
+
+    if (part == NULL){
+	if ((part = (ll_partition *) malloc(sizeof(ll_partition))) == NULL){
+	    perror("malloc");
+	    exit(-1);
+	}
+	ll->partition = part;
+    }else if (part->generation == ll->generation){
+	return part;
+    }
+
+    part->segment_count = ll->node_count < LL_MAX_SEGMENTS ?
+	ll->node_count : LL_MAX_SEGMENTS;
+    step = ll->node_count / part->segment_count;
+    extra = ll->node_count % part->segment_count;
+
+    n = ll->head;
+    for (s = 0; s < part->segment_count; s++){
+	part->lengths[s] = step + (s < extra ? 1 : 0);
+
+	/* The tower finds each start without walking the whole list */
+	if (ll->skip != NULL){
+	    part->starts[s] = ll_node_at(ll, index);
+	}else{
+	    part->starts[s] = n;
+	    for (i = 0; i < part->lengths[s]; i++)
+		n = n->next;
+	}
+	index += part->lengths[s];
+    }
+    if (ll->skip == NULL)
+	LL_STAT_SCAN(ll, ll->node_count);
+    part->generation = ll->generation;
+
+    return part;
+}
+
+/* Work shared by the threads of one parallel scan */
+typedef struct ll_parallel_job {
+    linked_list *ll;
+    /* Copy of the list with zeroed counters, copied by each worker */
+    linked_list local;
+    ll_partition *part;
+    /* Next segment to take */
+    atomic_uint next_segment;
+
+    /* ll_parallel_search() */
+    ll_probe probe;
+    /* Lowest segment with a hit so far */
+    atomic_uint found_segment;
+    node *hits[LL_MAX_SEGMENTS];
+
+    /* ll_parallel_for_each() */
+    void (*cb)(void *data, void *arg);
+    void *arg;
+
+    /* Protects the counters of the list */
+    pthread_mutex_t stats_lock;
+} ll_parallel_job;
+
+/*
+ * Make a private copy of the list for a worker thread. The workers
+ * count on their copies, and the counts are added to the list in
+ * the end by ll_parallel_add_stats(). Make the copy before the
+ * threads start, since they write the counters of the list.
+ */
+static void
+ll_parallel_local_copy(linked_list *ll, linked_list *local){
+    *local = *ll;
+    memset(&local->stats, 0, sizeof(ll_stats));
+}
+
+static void
+ll_parallel_add_stats(ll_parallel_job *job, const ll_stats *stats){
+#ifdef LL_STATS
+    pthread_mutex_lock(&job->stats_lock);
+    ll_stat_merge(&job->ll->stats, stats);
+    pthread_mutex_unlock(&job->stats_lock);
+#endif
+}
+
+/* How often a search checks if a lower segment has found the key */
+#define LL_PARALLEL_CHECK_INTERVAL 256
+
+static void *
+ll_parallel_search_worker(void *p){
+    ll_parallel_job *job = (ll_parallel_job *) p;
+    linked_list local;
+    unsigned int s, found;
+    uintptr_t i;
+    bool stop = false;
+    node *n;
+
+    local = job->local;
+
+    while(!stop && (s = atomic_fetch_add(&job->next_segment, 1)) <
+	  job->part->segment_count){
+	n = job->part->starts[s];
+	for (i = 0; i < job->part->lengths[s]; i++, n = n->next){
+	    /* A hit in a lower segment wins. Stop the later ones */
+	    if (i % LL_PARALLEL_CHECK_INTERVAL == 0 &&
+		atomic_load_explicit(&job->found_segment,
+				     memory_order_relaxed) < s){
+		stop = true;
+		break;
+	    }
+
+	    if (ll_compare_node_key(&local, n, &job->probe) == 0){
+		job->hits[s] = n;
+		found = atomic_load(&job->found_segment);
+		while(s < found &&
+		      !atomic_compare_exchange_weak(&job->found_segment,
+						    &found, s))
+		    ;
+		i++;
+		break;
+	    }
+	}
+	LL_STAT_SCAN(&local, i);
+    }
+
+    ll_parallel_add_stats(job, &local.stats);
+
+    return NULL;
+}
+
+static void *
+ll_parallel_for_each_worker(void *p){
+    ll_parallel_job *job = (ll_parallel_job *) p;
+    linked_list local;
+    unsigned int s;
+    uintptr_t i;
+    node *n;
+
+    local = job->local;
+
+    while((s = atomic_fetch_add(&job->next_segment, 1)) <
+	  job->part->segment_count){
+	n = job->part->starts[s];
+	for (i = 0; i < job->part->lengths[s]; i++, n = n->next)
+	    job->cb(n->data, job->arg);
+	LL_STAT_SCAN(&local, i);
+    }
+
+    ll_parallel_add_stats(job, &local.stats);
+
+    return NULL;
+}
+
+/* Run 'worker' on 'nthreads' threads, including the calling one */
+static void
+ll_parallel_run(ll_parallel_job *job, void *(*worker)(void *),
+		int nthreads){
+    pthread_t threads[LL_MAX_SEGMENTS];
+    int t;
+
+    if (nthreads > LL_MAX_SEGMENTS)
+	nthreads = LL_MAX_SEGMENTS;
+
+    for (t = 0; t < nthreads - 1; t++){
+	if (pthread_create(&threads[t], NULL, worker, job) != 0){
+	    perror("pthread_create");
+	    exit(-1);
+	}
+    }
+    worker(job);
+    for (t = 0; t < nthreads - 1; t++)
+	pthread_join(threads[t], NULL);
+}
+
+/*
+ * Same as ll_search_by_key(), scanning the segments of the list
+ * with 'nthreads' threads at the same time. The first data with
+ * the key in the list order is returned, and the threads scanning
+ * later segments stop as soon as an earlier segment finds it.
+ *
+ * The hash table and the tower are used instead when available,
+ * and small lists are scanned by the calling thread only.
+ */
+void *
+ll_parallel_search(linked_list *ll, void *key, int nthreads){
+    ll_parallel_job job;
+
+    if (!ll || !ll->head || !key || !ll->key_compare_cb)
+	return NULL;
+
+    if (ll->hash != NULL || ll_use_skip_index(ll) || nthreads <= 1 ||
+	ll->node_count < (uintptr_t) nthreads * LL_PARALLEL_MIN_NODES)
+	return ll_do_search_by_key(ll, key);
+
+    job.ll = ll;
+    job.part = ll_prepare_partition(ll);
+    atomic_init(&job.next_segment, 0);
+    ll_make_probe(ll, key, &job.probe);
+    atomic_init(&job.found_segment, UINT_MAX);
+    ll_parallel_local_copy(ll, &job.local);
+    pthread_mutex_init(&job.stats_lock, NULL);
+
+    ll_parallel_run(&job, ll_parallel_search_worker, nthreads);
+    pthread_mutex_destroy(&job.stats_lock);
+
+    if (atomic_load(&job.found_segment) == UINT_MAX)
+	return NULL;
+
+    return job.hits[atomic_load(&job.found_segment)]->data;
+}
+
+/*
+ * Call 'cb' for every data with 'nthreads' threads. The order of
+ * the calls is not defined.
+ */
+void
+ll_parallel_for_each(linked_list *ll, void (*cb)(void *data, void *arg),
+		     void *arg, int nthreads){
+    ll_parallel_job job;
+    node *n;
+
+    if (ll == NULL || cb == NULL)
+	return;
+
+    if (nthreads <= 1 ||
+	ll->node_count < (uintptr_t) nthreads * LL_PARALLEL_MIN_NODES){
+	for (n = ll->head; n != NULL; n = n->next)
+	    cb(n->data, arg);
+	LL_STAT_SCAN(ll, ll->node_count);
+	return;
+    }
+
+    job.ll = ll;
+    job.part = ll_prepare_partition(ll);
+    atomic_init(&job.next_segment, 0);
+    job.cb = cb;
+    job.arg = arg;
+    ll_parallel_local_copy(ll, &job.local);
+    pthread_mutex_init(&job.stats_lock, NULL);
+
+    ll_parallel_run(&job, ll_parallel_for_each_worker, nthreads);
+    pthread_mutex_destroy(&job.stats_lock);
+}
+
+/*
+ * Sort of segments [lo, hi) of the partition. Sort halves on two
+ * threads and merge them, down to one group of segments per thread.
+ */
+typedef struct ll_sort_task {
+    linked_list *ll;
+    ll_partition *part;
+    unsigned int lo, hi;
+    int nthreads;
+    /* Sorted chain of the segments */
+    node *result;
+    /* Counters of this task and its subtasks */
+    ll_stats stats;
+} ll_sort_task;
+
+static void *
+ll_parallel_sort_task(void *p){
+    ll_sort_task *task = (ll_sort_task *) p, left, right;
+    linked_list local;
+    pthread_t thread;
+    uintptr_t len = 0;
+    unsigned int s;
+    node *last;
+
+    ll_parallel_local_copy(task->ll, &local);
+
+    if (task->nthreads <= 1 || task->hi - task->lo <= 1){
+	/* Cut the own segments off the chain and sort them */
+	for (s = task->lo; s < task->hi; s++)
+	    len += task->part->lengths[s];
+	LL_STAT_SCAN(&local, len);
+	for (last = task->part->starts[task->lo]; len > 1; len--)
+	    last = last->next;
+	last->next = NULL;
+	task->result = ll_sort_chain(&local, task->part->starts[task->lo]);
+	task->stats = local.stats;
+
+	return NULL;
+    }
+
+    left = right = *task;
+    left.hi = right.lo = task->lo + (task->hi - task->lo) / 2;
+    left.nthreads = task->nthreads / 2;
+    right.nthreads = task->nthreads - left.nthreads;
+
+    if (pthread_create(&thread, NULL, ll_parallel_sort_task, &left) != 0){
+	perror("pthread_create");
+	exit(-1);
+    }
+    ll_parallel_sort_task(&right);
+    pthread_join(thread, NULL);
+
+    /* Left first keeps the sort stable */
+    task->result = ll_merge_chains(&local, left.result, right.result);
+    LL_STAT_MERGE(&local.stats, &left.stats);
+    LL_STAT_MERGE(&local.stats, &right.stats);
+    task->stats = local.stats;
+
+    return NULL;
+}
+
+/*
+ * Same as ll_sort(), with 'nthreads' threads. The segments of
+ * the list are cut and sorted in place at the same time, and
+ * merged in a tree of merges, without allocating any node.
+ * Small lists are sorted by the calling thread only.
+ */
+void
+ll_parallel_sort(linked_list *ll, int nthreads){
+    ll_sort_task task;
+
+    if (ll == NULL || ll->head == NULL || ll->key_compare_cb == NULL)
+	return;
+
+    if (nthreads <= 1 ||
+	ll->node_count < (uintptr_t) nthreads * LL_PARALLEL_MIN_NODES){
+	ll_sort(ll);
+	return;
+    }
+
+    task.ll = ll;
+    task.part = ll_prepare_partition(ll);
+    task.lo = 0;
+    task.hi = task.part->segment_count;
+    task.nthreads = nthreads;
+    ll_parallel_sort_task(&task);
+    LL_STAT_MERGE(&ll->stats, &task.stats);
 
-    return NULL;
+    ll_set_sorted_chain(ll, task.result);
 }
 
-/* Don't remove the hit node from the list */
-void *
-ll_search_by_key(linked_list *ll, void *key){
-    node *n;
-    void *parsed_key;
-
-    if (!ll || !ll->head || !key || !ll->key_compare_cb)
-	return NULL;
+bool
+ll_get_stats(linked_list *ll, ll_stats *stats){
+    assert(ll != NULL && stats != NULL);
 
-    n = ll->head;
-    while(n){
-	parsed_key = ll->key_access_cb == NULL ? n->data : ll->key_access_cb(n->data);
+#ifdef LL_STATS
+    *stats = ll->stats;
 
-	if (ll->key_compare_cb(parsed_key, key,
-			       ll->keys_compare_metadata) == 0){
-	    return n->data;
-	}
-	n = n->next;
-    }
+    return true;
+#else
+    memset(stats, 0, sizeof(ll_stats));
 
-    return NULL;
+    return false;
+#endif
 }
 
-void *
-ll_remove_by_key(linked_list *ll, void *key){
-    bool found = false;
-    node *prev, *cur;
-    void *p, *parsed_key;
-
-    if (!ll || !key || !ll->head || !ll->key_compare_cb)
-	return NULL;
+void
+ll_reset_stats(linked_list *ll){
+    assert(ll != NULL);
 
-    prev = cur = ll->head;
-    while(cur){
-	parsed_key = ll->key_access_cb == NULL ? cur->data : ll->key_access_cb(cur->data);
+    memset(&ll->stats, 0, sizeof(ll_stats));
+}
 
-	if (ll->key_compare_cb(parsed_key, key,
-			       ll->keys_compare_metadata) == 0){
-	    found = true;
-	    break;
-	}
-	prev = cur;
-	cur = cur->next;
-    }
+void
+ll_set_trace_hook(ll_trace_cb hook, void *arg){
+    ll_trace_hook = hook;
+    ll_trace_arg = arg;
+}
 
-    if (!found)
-	return NULL;
+bool
+ll_get_latency(linked_list *ll, ll_op op, ll_latency *latency){
+    assert(ll != NULL && latency != NULL);
+    assert(op < LL_OP_COUNT);
 
-    if (ll->head == cur){
-	/* the first node */
-	ll->head = cur->next;
-	cur->next = NULL;
-	p = cur->data;
-    }else if (cur->next == NULL){
-	/* the last node */
-	assert(prev != NULL);
-	prev->next = NULL;
-	p = cur->data;
-    }else{
-	/* a node in the middle of other nodes */
-	prev->next = cur->next;
-	cur->next = NULL;
-	p = cur->data;
-    }
+    if (ll->latency == NULL)
+	return false;
 
-    ll->node_count--;
-    free(cur);
+    *latency = ll->latency[op];
 
-    return p;
+    return true;
 }
 
-void *
-ll_replace_by_key(linked_list *ll, void *old_key, void *new_data){
-    node *curr;
-    void *parsed_key;
+void
+ll_reset_latency(linked_list *ll){
+    assert(ll != NULL);
 
-    if (ll == NULL || ll->head == NULL)
-	return NULL;
+    if (ll->latency != NULL)
+	memset(ll->latency, 0, LL_OP_COUNT * sizeof(ll_latency));
+}
 
-    curr = ll->head;
-    while(true){
-	parsed_key = ll->key_access_cb == NULL ? curr->data : ll->key_access_cb(curr->data);
+uint64_t
+ll_latency_percentile(const ll_latency *latency, double percentile){
+    uint64_t rank, seen = 0, upper;
+    int i;
 
-	if (ll->key_compare_cb(parsed_key, old_key,
-			       ll->keys_compare_metadata) == 0){
-	    void *tmp = curr->data;
+    assert(latency != NULL);
 
-	    curr->data = new_data;
+    if (latency->count == 0)
+	return 0;
 
-	    return tmp;
+    /* Number of operations within the percentile, rounded up */
+    rank = percentile / 100 * latency->count;
+    if (rank < percentile / 100 * latency->count)
+	rank++;
+    if (rank == 0)
+	rank = 1;
+
+    for (i = 0; i < LL_LATENCY_BUCKETS - 1; i++){
+	if ((seen += latency->buckets[i]) >= rank){
+	    upper = ((uint64_t) 2 << i) - 1;
+	    return upper < latency->max_ns ? upper : latency->max_ns;
 	}
-
-	if ((curr = curr->next) == NULL)
-	    break;
     }
 
-    return NULL;
+    return latency->max_ns;
 }
 
+/*
+ * Binary format of ll_serialize().
+ *
+ * The header consists of the magic, the version, the flags and
+ * the number of records, in little-endian. Each record follows
+ * as its length in LEB128 and its bytes.
+ */
+#define LL_SERIAL_MAGIC "LLST"
+#define LL_SERIAL_VERSION 1
+#define LL_SERIAL_HEADER_SIZE 20
+
+/* The records are in ascending order of keys */
+#define LL_SERIAL_SORTED 0x1
+
+/* Longest LEB128 of 64 bits */
+#define LL_VARINT_MAX 10
+
+/* Initial size of the buffer of ll_io */
+#define LL_IO_BUFFER_SIZE (1 << 20)
+
+/* Buffered reads or writes of a file descriptor */
+typedef struct ll_io {
+    int fd;
+    unsigned char *buf;
+    size_t size;
+    /* Next byte to read or write */
+    size_t pos;
+    /* Bytes read into 'buf' */
+    size_t len;
+} ll_io;
+
+static void
+ll_io_open(ll_io *io, int fd){
+    io->fd = fd;
+    io->size = LL_IO_BUFFER_SIZE;
+    if ((io->buf = (unsigned char *) malloc(io->size)) == NULL){
+	perror("malloc");
+	exit(-1);
+    }
+    io->pos = io->len = 0;
+}
 
-void *
-ll_tail_remove(linked_list *ll){
-    node *prev, *curr;
-    int i, list_len = ll_get_length(ll);
-    void *data;
-
-    if (ll == NULL || ll->head == NULL)
-	return NULL;
-
-    if (list_len == 1)
-	return ll_remove_first_data(ll);
+/* Write out the buffered bytes. Return false on error */
+static bool
+ll_io_flush(ll_io *io){
+    size_t done = 0;
+    ssize_t n;
+
+    while(done < io->pos){
+	if ((n = write(io->fd, io->buf + done, io->pos - done)) < 0){
+	    if (errno == EINTR)
+		continue;
+	    return false;
+	}
+	done += n;
+    }
+    io->pos = 0;
 
-    ll->node_count--;
+    return true;
+}
 
-    curr = ll->head;
-    for (i = 1; i <= (list_len - 1); i++){
-	prev = curr;
-	curr = curr->next;
+static bool
+ll_io_write(ll_io *io, const void *p, size_t len){
+    const unsigned char *bytes = (const unsigned char *) p;
+    size_t chunk;
+
+    while(len > 0){
+	if (io->pos == io->size && !ll_io_flush(io))
+	    return false;
+	chunk = io->size - io->pos < len ? io->size - io->pos : len;
+	memcpy(io->buf + io->pos, bytes, chunk);
+	io->pos += chunk;
+	bytes += chunk;
+	len -= chunk;
     }
 
-    assert(curr->next == NULL);
-    data = curr->data;
-    free(curr);
-    prev->next = NULL;
-
-    return data;
+    return true;
 }
 
-void
-ll_remove_all(linked_list *ll){
-    void *p;
+/*
+ * Make 'len' bytes readable from io->buf + io->pos, growing the
+ * buffer for a long record. Return false at the end of the file,
+ * on a read error, or when the buffer can't be that large.
+ */
+static bool
+ll_io_need(ll_io *io, size_t len){
+    unsigned char *buf;
+    ssize_t n;
 
-    while(true){
-	p = ll_remove_first_data(ll);
+    if (io->len - io->pos >= len)
+	return true;
 
-	/* are we done ? */
-	if (!p)
-	    break;
+    /* Move the rest to the front and read after it */
+    memmove(io->buf, io->buf + io->pos, io->len - io->pos);
+    io->len -= io->pos;
+    io->pos = 0;
+
+    /* A broken length mustn't abort the process */
+    if (len > io->size){
+	if ((buf = (unsigned char *) realloc(io->buf, len)) == NULL)
+	    return false;
+	io->buf = buf;
+	io->size = len;
+    }
 
-	/* found a node */
-	if (ll->free_cb){
-	    ll->free_cb(p);
+    while(io->len < len){
+	if ((n = read(io->fd, io->buf + io->len, io->size - io->len)) < 0){
+	    if (errno == EINTR)
+		continue;
+	    return false;
 	}
+	if (n == 0)
+	    return false;
+	io->len += n;
     }
+
+    return true;
 }
 
-linked_list *
-ll_split(linked_list *ll, int no_nodes){
-    linked_list *new_list;
-    void *p;
+static void
+ll_put_le(unsigned char *p, uint64_t v, int bytes){
     int i;
 
-    if (ll_get_length(ll) < no_nodes){
-	return ll;
-    }else if (no_nodes <= 0){
-	return ll;
+    for (i = 0; i < bytes; i++)
+	p[i] = (unsigned char) (v >> (8 * i));
+}
+
+static uint64_t
+ll_get_le(const unsigned char *p, int bytes){
+    uint64_t v = 0;
+    int i;
+
+    for (i = 0; i < bytes; i++)
+	v |= (uint64_t) p[i] << (8 * i);
+
+    return v;
+}
+
+/* Write 'v' in LEB128 to 'p' and return the number of bytes */
+static size_t
+ll_put_varint(unsigned char *p, uint64_t v){
+    size_t n = 0;
+
+    while(v >= 0x80){
+	p[n++] = (unsigned char) (v | 0x80);
+	v >>= 7;
     }
+    p[n++] = (unsigned char) v;
 
-    new_list = ll_init(ll->key_access_cb,
-		       ll->key_compare_cb,
-		       ll->free_cb,
-		       ll->keys_compare_metadata);
+    return n;
+}
 
-    for (i = 0; i < no_nodes; i++){
-	p = ll_remove_first_data(ll);
-	ll_tail_insert(new_list, p);
+static bool
+ll_io_get_varint(ll_io *io, uint64_t *v){
+    unsigned char byte;
+    int shift;
+
+    *v = 0;
+    for (shift = 0; shift < 64; shift += 7){
+	if (!ll_io_need(io, 1))
+	    return false;
+	byte = io->buf[io->pos++];
+	*v |= (uint64_t) (byte & 0x7f) << shift;
+	if ((byte & 0x80) == 0)
+	    return true;
     }
 
-    return new_list;
+    return false;
 }
 
 /*
- * If either list is empty, move the left keys to the
- * newly created linked list. In any case, drain both
- * input lists completely.
+ * Encode 'data' into the buffer right after its length. Records
+ * which don't fit in the rest of the buffer go through 'scratch'.
  */
-linked_list *
-ll_merge(linked_list *ll1, linked_list *ll2){
-    void *d1 = NULL, *d2 = NULL;
-    void *parsed_d1, *parsed_d2;
-    linked_list *result;
-    int cmp;
-    bool d1_shift, d2_shift;
-
-    /* Are the two lists joinable ? */
-    assert(ll1->key_access_cb == ll2->key_access_cb);
-    assert(ll1->key_compare_cb == ll2->key_compare_cb);
-    assert(ll1->free_cb == ll2->free_cb);
-    assert(ll1->keys_compare_metadata == ll2->keys_compare_metadata);
+static bool
+ll_io_write_record(ll_io *io, void *data, ll_encode_cb encode_cb, void *arg,
+		   unsigned char **scratch, size_t *scratch_size){
+    unsigned char prefix[LL_VARINT_MAX];
+    size_t room, len, prefix_len;
 
-    result = ll_init(ll1->key_access_cb,
-		     ll1->key_compare_cb,
-		     ll1->free_cb,
-		     ll1->keys_compare_metadata);
+    if (io->size - io->pos <= LL_VARINT_MAX && !ll_io_flush(io))
+	return false;
 
-    /* Handle the cases of empty list */
-    if (ll_get_length(ll1) == 0 && ll_get_length(ll2) == 0)
-	return result;
+    /*
+     * Leave one byte for the length, which is enough for records
+     * shorter than 128 bytes. Longer ones are moved after it.
+     */
+    room = io->size - io->pos - LL_VARINT_MAX;
+    len = encode_cb(data, io->buf + io->pos + 1, room, arg);
+    prefix_len = ll_put_varint(prefix, len);
+    if (len <= room){
+	if (prefix_len > 1)
+	    memmove(io->buf + io->pos + prefix_len, io->buf + io->pos + 1,
+		    len);
+	memcpy(io->buf + io->pos, prefix, prefix_len);
+	io->pos += prefix_len + len;
+	return true;
+    }
 
-    if (ll_get_length(ll1) == 0 && ll_get_length(ll2) != 0){
-	while(ll_get_length(ll2) > 0)
-	    ll_tail_insert(result, ll_remove_first_data(ll2));
-	return result;
+    if (*scratch_size < len){
+	free(*scratch);
+	if ((*scratch = (unsigned char *) malloc(len)) == NULL){
+	    perror("malloc");
+	    exit(-1);
+	}
+	*scratch_size = len;
     }
+    encode_cb(data, *scratch, len, arg);
+
+    return ll_io_write(io, prefix, prefix_len) &&
+	ll_io_write(io, *scratch, len);
+}
+
+int
+ll_serialize(linked_list *ll, int fd, ll_encode_cb encode_cb, void *arg){
+    unsigned char header[LL_SERIAL_HEADER_SIZE], *scratch = NULL;
+    size_t scratch_size = 0;
+    ll_io io;
+    node *n;
+    bool ok;
 
-    if (ll_get_length(ll1) != 0 && ll_get_length(ll2) == 0){
-	while(ll_get_length(ll1) > 0)
-	    ll_tail_insert(result, ll_remove_first_data(ll1));
-	return result;
+    if (ll == NULL || encode_cb == NULL){
+	errno = EINVAL;
+	return -1;
     }
 
-    /* We have two lists with data to merge */
-    d1_shift = d2_shift = true;
-    do {
-	if (d1_shift){
-	    d1 = ll_remove_first_data(ll1);
-	    if (d1 == NULL)
-		break;
-	}
+    memcpy(header, LL_SERIAL_MAGIC, 4);
+    ll_put_le(header + 4, LL_SERIAL_VERSION, 4);
+    ll_put_le(header + 8, ll_keys_ascending(ll) ? LL_SERIAL_SORTED : 0, 4);
+    ll_put_le(header + 12, ll->node_count, 8);
 
-	if (d2_shift){
-	    d2 = ll_remove_first_data(ll2);
-	    if (d2 == NULL)
-		break;
-	}
+    ll_io_open(&io, fd);
+    ok = ll_io_write(&io, header, sizeof(header));
+    for (n = ll->head; ok && n != NULL; n = n->next)
+	ok = ll_io_write_record(&io, n->data, encode_cb, arg,
+				&scratch, &scratch_size);
+    LL_STAT_SCAN(ll, ll->node_count);
+    ok = ok && ll_io_flush(&io);
 
-	d1_shift = d2_shift = false;
+    free(scratch);
+    free(io.buf);
 
-	/* Fetch keys */
-	parsed_d1 = result->key_access_cb == NULL ? d1 : result->key_access_cb(d1);
-	parsed_d2 = result->key_access_cb == NULL ? d2 : result->key_access_cb(d2);
+    return ok ? 0 : -1;
+}
 
-	cmp = result->key_compare_cb(parsed_d1,
-				     parsed_d2,
-				     result->keys_compare_metadata);
+int
+ll_deserialize(int fd, ll_decode_cb decode_cb, void *arg, linked_list *ll){
+    uint64_t flags = 0, count = 0, i, len;
+    ll_io io;
+    void *data;
+    bool ok;
 
-	if (cmp == -1 || cmp == 0){
-	    /* d1 key < d2 key or those are equal */
-	    ll_tail_insert(result, d1);
-	    d1_shift = true;
-	}else{
-	    /* d1 key > d2 key */
-	    ll_tail_insert(result, d2);
-	    d2_shift = true;
-	}
+    if (ll == NULL || decode_cb == NULL || ll->node_count != 0){
+	errno = EINVAL;
+	return -1;
+    }
 
-    } while(true);
+    ll_io_open(&io, fd);
+    ok = ll_io_need(&io, LL_SERIAL_HEADER_SIZE) &&
+	memcmp(io.buf, LL_SERIAL_MAGIC, 4) == 0 &&
+	ll_get_le(io.buf + 4, 4) == LL_SERIAL_VERSION;
+    if (ok){
+	flags = ll_get_le(io.buf + 8, 4);
+	count = ll_get_le(io.buf + 12, 8);
+	io.pos += LL_SERIAL_HEADER_SIZE;
+    }
 
-    /*
-     * After break, we have one element left in
-     * either d1 or d2. Don't forget to add the left
-     * one.
-     */
-    if (d1 != NULL)
-	ll_tail_insert(result, d1);
-    if (d2 != NULL)
-	ll_tail_insert(result, d2);
+    for (i = 0; ok && i < count; i++){
+	if (!ll_io_get_varint(&io, &len) || len > SIZE_MAX ||
+	    !ll_io_need(&io, len) ||
+	    (data = decode_cb(io.buf + io.pos, len, arg)) == NULL){
+	    ok = false;
+	    break;
+	}
+	io.pos += len;
 
-    /*
-     * Either input list is now empty,
-     * but the other one isn't. Continue to insert
-     * until the remaining list becomes empty.
-     */
-    while(ll_get_length(ll1) > 0)
-	ll_tail_insert(result, ll_remove_first_data(ll1));
+	/* Append without ll_link_node(), which updates the indexes */
+	ll_append_node(ll, ll_gen_node(ll, data));
+    }
 
-    while(ll_get_length(ll2) > 0)
-	ll_tail_insert(result, ll_remove_first_data(ll2));
+    free(io.buf);
 
-    assert(ll1->head == NULL);
-    assert(ll2->head == NULL);
+    if (!ok){
+	ll_remove_all(ll);
+	return -1;
+    }
 
-    return result;
+    /* Index all nodes at once, trusting the order of the saved list */
+    ll_rebuild_indexes(ll);
+    ll->keys_sorted = (flags & LL_SERIAL_SORTED) != 0;
+
+    return 0;
 }
 
 void
-ll_begin_iter(linked_list *ll){
-    assert(ll->iter_in_progress == false);
-    assert(ll->current_node == NULL);
-
-    ll->iter_in_progress = true;
-    /* Set the node which will be referenced next */
-    ll->current_node = ll->head;
+ll_iter_begin(linked_list *ll, ll_iter *iter){
+    unsigned int i;
+
+    assert(ll != NULL && iter != NULL);
+
+    iter->ll = ll;
+    iter->next = ll->head;
+
+    /* The caller reads the data, even when the key is cached */
+    iter->ahead = NULL;
+    if (ll->attr.prefetch_distance > 0){
+	iter->ahead = ll->head;
+	for (i = 0; i < ll->attr.prefetch_distance && iter->ahead != NULL;
+	     i++){
+	    __builtin_prefetch(iter->ahead->data);
+	    iter->ahead = iter->ahead->next;
+	}
+    }
 }
 
-void *
-ll_get_iter_data(linked_list *ll){
-    node *n;
-
-    assert(ll->iter_in_progress == true);
-
-    n = ll->current_node;
+/*
+ * Set 'data' to the next data and return true. Return false
+ * at the end of the list. Unlike ll_get_iter_data(), NULL
+ * data in the list is distinguished from the end.
+ */
+bool
+ll_iter_next(ll_iter *iter, void **data){
+    node *n = iter->next;
 
-    /* If the current node is null, then return null */
     if (n == NULL)
-	return NULL;
-    else{
-	/* Shift the node to the next one for the next call */
-	ll->current_node = ll->current_node->next;
-	return n->data;
+	return false;
+
+    if (iter->ahead != NULL){
+	__builtin_prefetch(iter->ahead->data);
+	__builtin_prefetch(iter->ahead->next);
+	iter->ahead = iter->ahead->next;
     }
+
+    iter->next = n->next;
+    *data = n->data;
+
+    return true;
 }
 
 void
-ll_end_iter(linked_list *ll){
-    assert(ll->iter_in_progress == true);
-
-    ll->iter_in_progress = false;
-    ll->current_node = NULL;
+ll_iter_end(ll_iter *iter){
+    iter->ll = NULL;
+    iter->next = NULL;
+    iter->ahead = NULL;
 }
 
 void
 ll_destroy(linked_list *ll){
-    if (ll == NULL || ll->head == NULL){
-	free(ll);
+    if (ll == NULL)
 	return;
-    }
 
     ll_remove_all(ll);
 
     assert(ll_get_length(ll) == 0);
 
+    if (ll->pool != NULL)
+	ll_pool_unref(ll->pool);
+
+    if (ll->skip != NULL)
+	ll_skip_destroy(ll->skip);
+
+    if (ll->hash != NULL)
+	ll_hash_destroy(ll->hash);
+
+    free(ll->partition);
+    free(ll->latency);
+
     free(ll);
 }
 
-/*
- * Insert an entry in ascending order and return
- * the index of inserted position.
- *
- * Return -1 on failure. The return value starts
- * from 0 as the first index.
- */
-int
-ll_asc_insert(linked_list *ll, void *new_data){
-    node *new_node, *prev, *curr;
-    void *parsed_key, *new_data_key;
-    bool found_larger_key = false;
+static int
+ll_do_asc_insert(linked_list *ll, void *new_data){
+    node *new_node, *prev, *curr, *ahead;
+    ll_probe probe;
     int inserted_pos = 0;
 
     if (!ll)
 	return -1;
 
-    new_node = ll_gen_node(new_data);
+    new_node = ll_gen_node(ll, new_data);
+    ll_make_probe(ll, ll_node_key(ll, new_node), &probe);
 
-    /* If there is no node, just insert. */
-    if (!ll->head){
-	ll->node_count++;
-	ll->head = new_node;
-	return 0;
-    }
+    /*
+     * Find the first node whose key is larger than the new
+     * one and insert before it. In other words, reconnect
+     * nodes in the order of 'prev', 'new_node' and 'curr'.
+     * If there is no such node, insert at the end.
+     */
+    if (ll_use_skip_index(ll)){
+	inserted_pos = ll_skip_find_key(ll, &probe, true, &prev);
+	ll_link_node(ll, prev, new_node, inserted_pos);
 
-    prev = curr = ll->head;
-    do {
-	parsed_key = ll->key_access_cb == NULL ? curr->data : ll->key_access_cb(curr->data);
-	new_data_key = ll->key_access_cb == NULL ? new_node->data: ll->key_access_cb(new_node->data);
+	return inserted_pos;
+    }
 
-	if (ll->key_compare_cb(parsed_key,
-			       new_data_key,
-			       ll->keys_compare_metadata) == 1){
-	    found_larger_key = true;
+    prev = NULL;
+    ahead = ll_prefetch_start(ll, ll->head);
+    for (curr = ll->head; curr != NULL; curr = curr->next){
+	ahead = ll_prefetch_step(ll, ahead);
+	if (ll_compare_node_key(ll, curr, &probe) > 0)
 	    break;
-	}
 	prev = curr;
 	inserted_pos++;
-    } while((curr = curr->next) != NULL);
-
-    if (found_larger_key == true){
-	assert(prev != NULL);
-	assert(curr != NULL);
-	ll->node_count++;
-	if (prev == curr){
-	    /*
-	     * If the smaller key is the first node,
-	     * then need to reconnect the list's head
-	     * as well.
-	     */
-	    ll->head = new_node;
-	    new_node->next = curr;
-	}else{
-	    /*
-	     * Insert before the smaller key. In other
-	     * words, reconnect nodes in the order of
-	     * 'prev', 'new_node' and 'curr'.
-	     */
-	    new_node->next = curr;
-	    prev->next = new_node;
-	}
-    }else{
-	/* Insert at the end */
-	assert(curr == NULL);
-	ll->node_count++;
-	prev->next = new_node;
     }
+    LL_STAT_SCAN(ll, curr == NULL ? inserted_pos : inserted_pos + 1);
+
+    ll_link_node(ll, prev, new_node, inserted_pos);
 
     return inserted_pos;
 }
 
+/*
+ * Insert an entry in ascending order and return
+ * the index of inserted position.
+ *
+ * Return -1 on failure. The return value starts
+ * from 0 as the first index.
+ */
+int
+ll_asc_insert(linked_list *ll, void *new_data){
+    ll_trace_point tp;
+    int pos;
+
+    if (!ll_trace_begin(ll, &tp))
+	return ll_do_asc_insert(ll, new_data);
+
+    pos = ll_do_asc_insert(ll, new_data);
+    ll_trace_end(ll, LL_OP_ASC_INSERT, &tp);
+
+    return pos;
+}
+
 void
 ll_index_insert(linked_list *ll, void *new_data, int index){
+    node *prev;
+
     if (!ll || index < 0)
 	return;
 
@@ -564,23 +3115,10 @@ ll_index_insert(linked_list *ll, void *new_data, int index){
     }else if(index == ll_get_length(ll)){
 	ll_tail_insert(ll, new_data);
     }else{
-	node *prev, *curr, *new_node;
-	int iter = 0;
-
-	new_node = ll_gen_node(new_data);
-	prev = curr = ll->head;
-	do {
-	    if (iter == index){
-		new_node->next = curr;
-		prev->next = new_node;
-		ll->node_count++;
-		return;
-	    }
-	    prev = curr;
-	    iter++;
-	} while((curr = curr->next) != NULL);
+	/* Find the node just before the index */
+	prev = ll_node_at(ll, index - 1);
 
-	assert(0);
+	ll_link_node(ll, prev, ll_gen_node(ll, new_data), index);
     }
 }
 
@@ -588,7 +3126,6 @@ void *
 ll_index_remove(linked_list *ll, int index){
     node *prev, *curr;
     void *data;
-    int i = 0;
 
     if (ll == NULL || ll->head == NULL ||
 	index < 0 || ll_get_length(ll) - 1 < index)
@@ -602,63 +3139,30 @@ ll_index_remove(linked_list *ll, int index){
     if (index == ll_get_length(ll) - 1)
 	return ll_tail_remove(ll);
 
-    prev = curr = ll->head;
-
-    while(true){
-
-	if (i == index){
-	    /* This must be an internal node */
-	    assert(curr->next != NULL);
-
-	    ll->node_count--;
-	    prev->next = curr->next;
-
-	    data = curr->data;
-
-	    /* free the node */
-	    if (ll->free_cb)
-		ll->free_cb(data);
-	    curr->data = NULL;
-	    curr->next = NULL;
-	    free(curr);
+    /* Find the node just before the index */
+    prev = ll_node_at(ll, index - 1);
+    curr = prev->next;
 
-	    return data;
-	}
+    /* This must be an internal node */
+    assert(curr->next != NULL);
+    ll_unlink_node(ll, prev, curr, index);
 
-	i++;
-	prev = curr;
-	curr = curr->next;
-	if (curr == NULL)
-	    break;
-    }
+    data = curr->data;
 
-    assert(0);
+    /* free the node */
+    if (ll->free_cb)
+	ll->free_cb(data);
+    curr->data = NULL;
+    ll_free_node(ll, curr);
 
-    return NULL;
+    return data;
 }
 
 bool
 ll_has_key(linked_list *ll, void *key)
 {
-    int i;
-    void *p, *parsed_key;
-
     if (ll == NULL || ll->head == NULL)
 	return false;
 
-    ll_begin_iter(ll);
-    for (i = 0; i < ll_get_length(ll); i++){
-	p = ll_get_iter_data(ll);
-
-	parsed_key = ll->key_access_cb == NULL ? p : ll->key_access_cb(p);
-
-	if (ll->key_compare_cb(parsed_key, key,
-			       ll->keys_compare_metadata) == 0){
-	    ll_end_iter(ll);
-	    return true;
-	}
-    }
-    ll_end_iter(ll);
-
-    return false;
+    return ll_find_node(ll, key, NULL, NULL) != NULL;
 }
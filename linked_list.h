@@ -2,12 +2,191 @@
 #define __LINKED_LIST__
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 typedef struct node {
     void *data;
     struct node *next;
 } node;
 
+/* Slab allocator of nodes. Defined in linked_list.c */
+struct ll_node_pool;
+
+/* Skip-list tower over the nodes. Defined in linked_list.c */
+struct ll_skip_index;
+
+/* Hash table from keys to nodes. Defined in linked_list.c */
+struct ll_hash_index;
+
+/* Segments for the parallel scans. Defined in linked_list.c */
+struct ll_partition;
+
+/*
+ * Optional settings of linked_list, passed to ll_init_with_attr().
+ *
+ * Zero-initialized members keep the default behavior of ll_init(),
+ * so set only the members to change.
+ */
+typedef struct ll_attr {
+
+    /*
+     * Number of nodes carved out of one slab.
+     *
+     * When this is set, nodes are taken from per-list slabs
+     * through a free list instead of calling malloc() and
+     * free() for every insertion and removal. All slabs are
+     * released at once by ll_remove_all() and ll_destroy().
+     */
+    unsigned int nodes_per_slab;
+
+    /*
+     * Link each node to its previous node as well, so that
+     * ll_tail_remove() doesn't need to walk the list. This
+     * costs one more pointer per node.
+     */
+    bool doubly_linked;
+
+    /*
+     * Keep a probabilistic skip-list tower over the nodes.
+     *
+     * The tower counts the nodes it skips. So, regardless of
+     * the order of keys, ll_ref_index_data(), ll_index_insert()
+     * and ll_index_remove() descend the tower by positions and
+     * take O(log n).
+     *
+     * While the keys are in ascending order (e.g. the list is
+     * built by ll_asc_insert()), ll_asc_insert(), ll_search_by_key(),
+     * ll_has_key(), ll_remove_by_key(), ll_replace_by_key() and
+     * ll_rank() descend the tower by keys as well. Other insertions
+     * are allowed, but once they break the order, the key
+     * operations fall back to the scans.
+     */
+    bool skip_index;
+
+    /*
+     * Hash the key. Must return the same value for keys which
+     * key_compare_cb regards as equal.
+     *
+     * When this is set, a hash table from keys to nodes is
+     * maintained, and ll_search_by_key(), ll_has_key(),
+     * ll_remove_by_key() and ll_replace_by_key() take O(1) on
+     * average. This implies the doubly_linked setting, so that
+     * a hit node can be removed without any walk. Intended for
+     * unique keys. When the keys are duplicated, which one of
+     * the equal keys is hit is not defined.
+     */
+    uint64_t (*key_hash_cb)(void *key, void *keys_compare_metadata);
+
+    /*
+     * Store the key returned by key_access_cb in each node at
+     * insertion, so that scans and comparisons read the key
+     * from the node instead of calling key_access_cb for every
+     * visited node. This costs one more pointer per node.
+     * ll_replace_by_key() refreshes the stored key. Don't
+     * change the key of data in the list by other means.
+     */
+    bool cache_keys;
+
+    /*
+     * Return a fixed-width prefix of the key which keeps the
+     * order of keys: when key_compare_cb says key1 < key2, the
+     * prefix of key1 must be equal to or smaller than the one
+     * of key2 (e.g. the first 8 bytes of a string in big-endian).
+     *
+     * When this is set, the prefix is stored in each node next
+     * to the cached key, and key comparisons check the prefixes
+     * inline first. key_compare_cb is called only when the two
+     * prefixes are equal. This implies the cache_keys setting
+     * and costs one more uint64_t per node.
+     */
+    uint64_t (*key_prefix_cb)(void *key, void *keys_compare_metadata);
+
+    /*
+     * Record the latency of each traced operation (see ll_op)
+     * in a log-bucketed histogram per operation type. Read them
+     * by ll_get_latency(). Costs two clock reads per operation.
+     */
+    bool latency_histograms;
+
+    /*
+     * Prefetch the node this many nodes ahead of the scans of
+     * ll_search_by_key(), ll_has_key(), ll_remove_by_key(),
+     * ll_asc_insert(), ll_rank() and ll_iter, together with the
+     * data (or the cached key) which the comparison touches, so
+     * that the memory accesses overlap with the comparisons. Up
+     * to LL_PREFETCH_MAX_DISTANCE. 0 takes the default of the
+     * build, which is no prefetching unless LL_PREFETCH_DISTANCE
+     * is defined.
+     */
+    unsigned int prefetch_distance;
+
+} ll_attr;
+
+#define LL_PREFETCH_MAX_DISTANCE 8
+
+/*
+ * Counters of the work done by a list, to find lists which have
+ * grown into hotspots. They are maintained only when the library
+ * is built with LL_STATS defined. Otherwise, nothing is counted
+ * and ll_get_stats() returns false.
+ *
+ * Note that with LL_STATS, even the functions which only read the
+ * list (e.g. ll_search_by_key()) update the counters.
+ */
+typedef struct ll_stats {
+
+    /*
+     * Nodes stepped on by the walks along the chain and the
+     * tower, and the entries probed in the hash table. Steps
+     * of ll_iter and ll_get_iter_data() aren't included.
+     */
+    uint64_t nodes_visited;
+
+    /* Calls of key_compare_cb and key_access_cb */
+    uint64_t key_compare_calls;
+    uint64_t key_access_calls;
+
+    /* Nodes taken from and returned to the node allocator */
+    uint64_t node_allocs;
+    uint64_t node_frees;
+
+    /* Most nodes visited by one walk */
+    uint64_t longest_scan;
+
+} ll_stats;
+
+/*
+ * Operations reported to the trace hook and recorded in the
+ * latency histograms.
+ */
+typedef enum ll_op {
+    LL_OP_ASC_INSERT,
+    LL_OP_SEARCH_BY_KEY,
+    LL_OP_REMOVE_BY_KEY,
+    LL_OP_MERGE,
+    LL_OP_SPLIT,
+    LL_OP_COUNT
+} ll_op;
+
+#define LL_LATENCY_BUCKETS 40
+
+/* Latency histogram of one operation type */
+typedef struct ll_latency {
+
+    /*
+     * buckets[i] counts the operations which took 2^i to
+     * 2^(i + 1) - 1 nanoseconds. The first bucket includes 0,
+     * and the last one includes all longer operations.
+     */
+    uint64_t buckets[LL_LATENCY_BUCKETS];
+
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+
+} ll_latency;
+
 /*
  * Expect only one caller just for now.
  */
@@ -17,6 +196,20 @@ typedef struct linked_list {
 
     node *head;
 
+    /* The last node. Makes tail insertion constant time */
+    node *tail;
+
+    /*
+     * The node resolved by the last positional access and its
+     * position. ll_ref_index_data(), ll_index_insert() and
+     * ll_index_remove() resume from here when the requested
+     * position is at or after it, which makes loops over
+     * increasing indexes linear. Note that this means even
+     * ll_ref_index_data() updates the list object.
+     */
+    node *finger;
+    uintptr_t finger_index;
+
     /*
      * Specify how to access key of application data.
      *
@@ -45,7 +238,10 @@ typedef struct linked_list {
 
     void (*free_cb)(void *data);
 
-    /* Iteration control */
+    /*
+     * Iteration control of ll_begin_iter(). Only one such
+     * iteration can be active. See ll_iter for independent ones.
+     */
     node *current_node;
     bool iter_in_progress;
 
@@ -59,14 +255,102 @@ typedef struct linked_list {
      */
     void *keys_compare_metadata;
 
+    /* Settings given at initialization */
+    ll_attr attr;
+
+    /* Bytes of one node, depending on the settings */
+    size_t node_size;
+
+    /* Offset of the cached key in a node. 0 unless keys are cached */
+    size_t key_offset;
+
+    /* Node allocator. NULL when nodes are malloc'ed one by one */
+    struct ll_node_pool *pool;
+
+    /* Skip-list tower. NULL unless the skip_index setting is on */
+    struct ll_skip_index *skip;
+
+    /* Hash table of keys. NULL unless key_hash_cb is set */
+    struct ll_hash_index *hash;
+
+    /*
+     * True while the keys are known to be in ascending order.
+     * Tracked only when the skip-list tower is maintained.
+     */
+    bool keys_sorted;
+
+    /* Incremented whenever the nodes are linked differently */
+    uint64_t generation;
+
+    /*
+     * Sampled start nodes of the segments scanned by the parallel
+     * functions. Rebuilt when the generation has changed.
+     */
+    struct ll_partition *partition;
+
+    /* Updated only when built with LL_STATS */
+    ll_stats stats;
+
+    /*
+     * Latency histograms indexed by ll_op. NULL unless the
+     * latency_histograms setting is on.
+     */
+    ll_latency *latency;
+
 } linked_list;
 
+/*
+ * Called after every traced operation with the list (the new
+ * list for ll_merge()), the number of visited nodes and the
+ * elapsed time. The number of visited nodes is taken from
+ * ll_stats, so it is always 0 unless built with LL_STATS.
+ */
+typedef void (*ll_trace_cb)(ll_op op, linked_list *ll, uint64_t visited,
+			    uint64_t ns, void *arg);
+
+/*
+ * Write the bytes of 'data' into 'buf' of 'size' bytes and return
+ * the number of bytes of the record. When it is larger than 'size',
+ * the callback is called again with a buffer large enough.
+ */
+typedef size_t (*ll_encode_cb)(void *data, void *buf, size_t size,
+			       void *arg);
+
+/*
+ * Build the data from the record of 'len' bytes in 'buf', which is
+ * valid only during the call. Return NULL on failure.
+ */
+typedef void *(*ll_decode_cb)(const void *buf, size_t len, void *arg);
+
+/*
+ * Iterator object, usually allocated on the stack.
+ *
+ * Unlike ll_begin_iter(), any number of iterations over one
+ * list may be active at the same time, including from several
+ * threads as long as no thread modifies the list. Don't modify
+ * the list during the iterations.
+ */
+typedef struct ll_iter {
+    linked_list *ll;
+    /* The node which will be returned next */
+    node *next;
+    /* The node to prefetch next. NULL without prefetching */
+    node *ahead;
+} ll_iter;
+
 linked_list *ll_init(void *(*key_access_cb)(void *data),
 		     int (*key_compare_cb)(void *key1,
 					   void *key2,
 					   void *metadata),
 		     void (*free_cb)(void *data),
 		     void *key_compare_metadata);
+linked_list *ll_init_with_attr(void *(*key_access_cb)(void *data),
+			       int (*key_compare_cb)(void *key1,
+						     void *key2,
+						     void *metadata),
+			       void (*free_cb)(void *data),
+			       void *key_compare_metadata,
+			       const ll_attr *attr);
 
 bool ll_is_empty(linked_list *ll);
 bool ll_has_key(linked_list *ll, void *key);
@@ -76,26 +360,102 @@ int ll_get_length(linked_list *ll);
 void ll_insert(linked_list *ll, void *p);
 void ll_tail_insert(linked_list *ll, void *p);
 int ll_asc_insert(linked_list *ll, void *p);
+/*
+ * Insert 'n' items in ascending order at once. Return -1 without
+ * inserting anything when the list is out of order or has no
+ * key_compare_cb, and 0 otherwise.
+ */
+int ll_asc_insert_batch(linked_list *ll, void **items, size_t n,
+			int *positions);
 void ll_index_insert(linked_list *ll, void *p, int index);
 void *ll_index_remove(linked_list *ll, int index);
 void *ll_remove_first_data(linked_list *ll);
 void *ll_ref_index_data(linked_list *ll, int index);
+int ll_rank(linked_list *ll, void *key);
 void *ll_search_by_key(linked_list *ll, void *key);
 void *ll_remove_by_key(linked_list *ll, void *key);
 void *ll_replace_by_key(linked_list *ll, void *old_key,
 			void *new_data);
 void *ll_tail_remove(linked_list *ll);
 void ll_remove_all(linked_list *ll);
+int ll_remove_if(linked_list *ll, bool (*pred)(void *data, void *ctx),
+		 void *ctx, linked_list *removed);
+int ll_retain_if(linked_list *ll, bool (*pred)(void *data, void *ctx),
+		 void *ctx, linked_list *removed);
 
 /* Some extra features */
 linked_list *ll_split(linked_list *ll, int no_nodes);
 linked_list *ll_merge(linked_list *ll1, linked_list *ll2);
+void ll_sort(linked_list *ll);
 
 /* iteration feature */
 void ll_begin_iter(linked_list *ll);
 void *ll_get_iter_data(linked_list *ll);
 void ll_end_iter(linked_list *ll);
 
+/*
+ * Parallel operations with 'nthreads' threads. The callbacks must
+ * be thread-safe, and no other thread may modify the list meanwhile.
+ */
+void *ll_parallel_search(linked_list *ll, void *key, int nthreads);
+void ll_parallel_for_each(linked_list *ll,
+			  void (*cb)(void *data, void *arg),
+			  void *arg, int nthreads);
+void ll_parallel_sort(linked_list *ll, int nthreads);
+
+/*
+ * Copy the counters to 'stats' and return true. When the library
+ * is built without LL_STATS, set 'stats' to zeros and return false.
+ */
+bool ll_get_stats(linked_list *ll, ll_stats *stats);
+void ll_reset_stats(linked_list *ll);
+
+/*
+ * Set the trace hook for all lists, or remove it by NULL. 'arg'
+ * is passed to the hook as it is. While no hook is set and the
+ * list has no latency histograms, tracing costs one branch per
+ * operation. Set the hook while no other thread uses any list.
+ */
+void ll_set_trace_hook(ll_trace_cb hook, void *arg);
+
+/*
+ * Copy the histogram of 'op' to 'latency' and return true.
+ * Return false when the list doesn't record latencies.
+ */
+bool ll_get_latency(linked_list *ll, ll_op op, ll_latency *latency);
+void ll_reset_latency(linked_list *ll);
+
+/*
+ * Return the upper bound of the bucket where the 'percentile'
+ * (0 to 100) of the recorded operations fall, in nanoseconds.
+ * Never more than the longest recorded latency.
+ */
+uint64_t ll_latency_percentile(const ll_latency *latency,
+			       double percentile);
+
+/*
+ * Write all data to 'fd' as length-prefixed records after a header,
+ * which records whether the keys are in ascending order. Return 0
+ * on success and -1 on a write error, with errno set.
+ */
+int ll_serialize(linked_list *ll, int fd, ll_encode_cb encode_cb,
+		 void *arg);
+
+/*
+ * Load the records written by ll_serialize() from 'fd' into 'll',
+ * which must be empty and use the same key_compare_cb as the saved
+ * list. The nodes are appended in the saved order without any key
+ * comparison, and the indexes are built once in the end. Return 0
+ * on success. On failure, return -1 and leave 'll' empty, after
+ * calling free_cb for the data decoded so far.
+ */
+int ll_deserialize(int fd, ll_decode_cb decode_cb, void *arg,
+		   linked_list *ll);
+
+void ll_iter_begin(linked_list *ll, ll_iter *iter);
+bool ll_iter_next(ll_iter *iter, void **data);
+void ll_iter_end(ll_iter *iter);
+
 void ll_destroy(linked_list *ll);
 
 #endif
@@ -0,0 +1,327 @@
+#ifndef __LINKED_LIST_TYPED__
+#define __LINKED_LIST_TYPED__
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Type-specialized linked lists generated at compile time.
+ *
+ *	LL_DEFINE(name, type, key_type, key_of, compare)
+ *
+ * defines the list type 'name' whose nodes store 'type' by value,
+ * and static inline functions 'name'_init(), 'name'_asc_insert() ...
+ * etc, which correspond to the ll_ functions of linked_list.h.
+ *
+ * 'key_of' and 'compare' are functions or function-like macros.
+ * key_of(const type *value) returns the key of the value as
+ * 'key_type', and compare(key_type key1, key_type key2) returns
+ * a negative value, 0 or a positive value, like key_compare_cb.
+ * Since both are visible to the compiler at each call site, they
+ * are inlined into the search loops.
+ *
+ * Example:
+ *
+ *	#define EMP_ID(e) ((e)->id)
+ *	LL_DEFINE(emp_list, employee, int, EMP_ID, LL_COMPARE_NUMBERS)
+ *
+ *	emp_list list;
+ *	emp_list_init(&list);
+ *	emp_list_asc_insert(&list, e);
+ *	employee *hit = emp_list_search_by_key(&list, 10);
+ */
+
+/* Comparison of arithmetic keys for 'compare' */
+#define LL_COMPARE_NUMBERS(key1, key2) (((key1) > (key2)) - ((key1) < (key2)))
+
+/* Use the value itself as the key for 'key_of' */
+#define LL_VALUE_AS_KEY(value) (*(value))
+
+#define LL_DEFINE(name, type, key_type, key_of, compare)		\
+									\
+typedef struct name##_node {						\
+    type value;								\
+    struct name##_node *next;						\
+} name##_node;								\
+									\
+typedef struct name {							\
+    uintptr_t node_count;						\
+    name##_node *head;							\
+    name##_node *tail;							\
+    /* Iteration control */						\
+    name##_node *current_node;						\
+    bool iter_in_progress;						\
+} name;									\
+									\
+static inline void							\
+name##_init(name *l){							\
+    l->node_count = 0;							\
+    l->head = l->tail = NULL;						\
+    l->current_node = NULL;						\
+    l->iter_in_progress = false;					\
+}									\
+									\
+static inline bool							\
+name##_is_empty(const name *l){						\
+    return l->node_count == 0;						\
+}									\
+									\
+static inline int							\
+name##_get_length(const name *l){					\
+    return l->node_count;						\
+}									\
+									\
+static inline name##_node *						\
+name##_gen_node(type value){						\
+    name##_node *n;							\
+									\
+    if ((n = (name##_node *) malloc(sizeof(name##_node))) == NULL){	\
+	perror("malloc");						\
+	exit(-1);							\
+    }									\
+    n->value = value;							\
+    n->next = NULL;							\
+									\
+    return n;								\
+}									\
+									\
+/* Connect 'n' just after 'prev', or at the head when 'prev' is NULL */	\
+static inline void							\
+name##_link_node(name *l, name##_node *prev, name##_node *n){		\
+    if (prev == NULL){							\
+	n->next = l->head;						\
+	l->head = n;							\
+    }else{								\
+	n->next = prev->next;						\
+	prev->next = n;							\
+    }									\
+    if (n->next == NULL)						\
+	l->tail = n;							\
+    l->node_count++;							\
+}									\
+									\
+static inline void							\
+name##_unlink_node(name *l, name##_node *prev, name##_node *n){		\
+    if (prev == NULL)							\
+	l->head = n->next;						\
+    else								\
+	prev->next = n->next;						\
+    if (l->tail == n)							\
+	l->tail = prev;							\
+    l->node_count--;							\
+}									\
+									\
+static inline void							\
+name##_insert(name *l, type value){					\
+    name##_link_node(l, NULL, name##_gen_node(value));			\
+}									\
+									\
+static inline void							\
+name##_tail_insert(name *l, type value){				\
+    name##_link_node(l, l->tail, name##_gen_node(value));		\
+}									\
+									\
+/* Insert after the equal keys and return the inserted position */	\
+static inline int							\
+name##_asc_insert(name *l, type value){					\
+    name##_node *prev = NULL, *curr;					\
+    key_type key = key_of(&value);					\
+    int pos = 0;							\
+									\
+    for (curr = l->head; curr != NULL; curr = curr->next){		\
+	if (compare(key_of(&curr->value), key) > 0)			\
+	    break;							\
+	prev = curr;							\
+	pos++;								\
+    }									\
+    name##_link_node(l, prev, name##_gen_node(value));			\
+									\
+    return pos;								\
+}									\
+									\
+/* Return the first node with 'key' and set 'prev' to its previous */	\
+static inline name##_node *						\
+name##_find_node(name *l, key_type key, name##_node **prev){		\
+    name##_node *p = NULL, *n;						\
+									\
+    for (n = l->head; n != NULL; n = n->next){				\
+	if (compare(key_of(&n->value), key) == 0)			\
+	    break;							\
+	p = n;								\
+    }									\
+    *prev = p;								\
+									\
+    return n;								\
+}									\
+									\
+/* Don't remove the hit value from the list */				\
+static inline type *							\
+name##_search_by_key(name *l, key_type key){				\
+    name##_node *prev, *n = name##_find_node(l, key, &prev);		\
+									\
+    return n == NULL ? NULL : &n->value;				\
+}									\
+									\
+static inline bool							\
+name##_has_key(name *l, key_type key){					\
+    return name##_search_by_key(l, key) != NULL;			\
+}									\
+									\
+/* Copy the removed value to 'out' unless it is NULL */			\
+static inline bool							\
+name##_remove_by_key(name *l, key_type key, type *out){			\
+    name##_node *prev, *n = name##_find_node(l, key, &prev);		\
+									\
+    if (n == NULL)							\
+	return false;							\
+    name##_unlink_node(l, prev, n);					\
+    if (out != NULL)							\
+	*out = n->value;						\
+    free(n);								\
+									\
+    return true;							\
+}									\
+									\
+static inline bool							\
+name##_remove_first_data(name *l, type *out){				\
+    name##_node *n = l->head;						\
+									\
+    if (n == NULL)							\
+	return false;							\
+    name##_unlink_node(l, NULL, n);					\
+    if (out != NULL)							\
+	*out = n->value;						\
+    free(n);								\
+									\
+    return true;							\
+}									\
+									\
+static inline type *							\
+name##_ref_index_data(name *l, int index){				\
+    name##_node *n;							\
+									\
+    if (index < 0 || name##_get_length(l) <= index)			\
+	return NULL;							\
+    if (index == name##_get_length(l) - 1)				\
+	return &l->tail->value;						\
+    for (n = l->head; index > 0; index--)				\
+	n = n->next;							\
+									\
+    return &n->value;							\
+}									\
+									\
+static inline void							\
+name##_remove_all(name *l){						\
+    name##_node *n, *next;						\
+									\
+    for (n = l->head; n != NULL; n = next){				\
+	next = n->next;							\
+	free(n);							\
+    }									\
+    l->head = l->tail = NULL;						\
+    l->node_count = 0;							\
+}									\
+									\
+/*									\
+ * Move the first 'no_nodes' nodes to 'first', which must be empty.	\
+ * Return false without moving anything when 'no_nodes' is out of	\
+ * range, like ll_split() returns the list itself.			\
+ */									\
+static inline bool							\
+name##_split(name *l, int no_nodes, name *first){			\
+    name##_node *last;							\
+    int i;								\
+									\
+    assert(name##_is_empty(first));					\
+    if (no_nodes <= 0 || name##_get_length(l) < no_nodes)		\
+	return false;							\
+									\
+    for (last = l->head, i = 1; i < no_nodes; i++)			\
+	last = last->next;						\
+    first->head = l->head;						\
+    first->tail = last;							\
+    first->node_count = no_nodes;					\
+									\
+    l->head = last->next;						\
+    if (l->head == NULL)						\
+	l->tail = NULL;							\
+    l->node_count -= no_nodes;						\
+    last->next = NULL;							\
+									\
+    return true;							\
+}									\
+									\
+/*									\
+ * Merge 'l1' and 'l2' in ascending order into 'result', which must	\
+ * be empty, relinking the nodes. Both input lists become empty.	\
+ */									\
+static inline void							\
+name##_merge(name *l1, name *l2, name *result){				\
+    name##_node *n;							\
+									\
+    assert(name##_is_empty(result));					\
+    while(l1->head != NULL && l2->head != NULL){			\
+	if (compare(key_of(&l1->head->value),				\
+		    key_of(&l2->head->value)) <= 0){			\
+	    n = l1->head;						\
+	    name##_unlink_node(l1, NULL, n);				\
+	}else{								\
+	    n = l2->head;						\
+	    name##_unlink_node(l2, NULL, n);				\
+	}								\
+	name##_link_node(result, result->tail, n);			\
+    }									\
+									\
+    /* Append the rest of the remaining list at once */		\
+    n = l1->head != NULL ? l1->head : l2->head;				\
+    if (n != NULL){							\
+	if (result->tail == NULL)					\
+	    result->head = n;						\
+	else								\
+	    result->tail->next = n;					\
+	result->tail = l1->head != NULL ? l1->tail : l2->tail;		\
+	result->node_count += l1->node_count + l2->node_count;		\
+    }									\
+    l1->head = l1->tail = l2->head = l2->tail = NULL;			\
+    l1->node_count = l2->node_count = 0;				\
+}									\
+									\
+static inline void							\
+name##_begin_iter(name *l){						\
+    assert(l->iter_in_progress == false);				\
+									\
+    l->iter_in_progress = true;						\
+    l->current_node = l->head;						\
+}									\
+									\
+/* Return NULL at the end of the list */				\
+static inline type *							\
+name##_get_iter_data(name *l){						\
+    name##_node *n = l->current_node;					\
+									\
+    assert(l->iter_in_progress == true);				\
+									\
+    if (n == NULL)							\
+	return NULL;							\
+    l->current_node = n->next;						\
+									\
+    return &n->value;							\
+}									\
+									\
+static inline void							\
+name##_end_iter(name *l){						\
+    assert(l->iter_in_progress == true);				\
+									\
+    l->iter_in_progress = false;					\
+    l->current_node = NULL;						\
+}									\
+									\
+static inline void							\
+name##_destroy(name *l){						\
+    name##_remove_all(l);						\
+}
+
+#endif
@@ -0,0 +1,166 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../concurrent_list.h"
+
+#define THREADS 8
+#define KEYS_PER_THREAD 2000
+#define SHARED_KEYS 64
+
+static int
+uintptr_key_match(void *key1, void *key2, void *metadata){
+    uintptr_t k1 = (uintptr_t) key1,
+	k2 = (uintptr_t) key2;
+
+    if (k1 < k2)
+	return -1;
+    else if (k1 == k2)
+	return 0;
+    else
+	return 1;
+}
+
+/* Number of freed data, counted by free_cb */
+static atomic_int freed;
+
+static void
+counted_free(void *data){
+    atomic_fetch_add(&freed, 1);
+}
+
+static void
+check_order(void *data, void *arg){
+    uintptr_t *last = (uintptr_t *) arg;
+
+    assert(*last < (uintptr_t) data);
+    *last = (uintptr_t) data;
+}
+
+static void
+test_single_thread(void){
+    concurrent_list *cl;
+    uintptr_t i, last = 0;
+
+    cl = cl_init(NULL, uintptr_key_match, NULL, NULL);
+    for (i = 1; i <= 100; i++)
+	assert(cl_insert(cl, (void *) ((i * 37) % 100 + 1)));
+    assert(!cl_insert(cl, (void *) 50));
+    assert(cl_get_length(cl) == 100);
+
+    cl_for_each(cl, check_order, &last);
+    assert(last == 100);
+
+    assert(cl_search_by_key(cl, (void *) 42) == (void *) 42);
+    assert(cl_remove_by_key(cl, (void *) 42) == (void *) 42);
+    assert(cl_remove_by_key(cl, (void *) 42) == NULL);
+    assert(!cl_has_key(cl, (void *) 42));
+    assert(cl_has_key(cl, (void *) 43));
+    assert(cl_get_length(cl) == 99);
+
+    cl_destroy(cl);
+}
+
+typedef struct worker_arg {
+    concurrent_list *cl;
+    uintptr_t id;
+    /* Successful insertions and removals of each shared key */
+    int inserted[SHARED_KEYS];
+    int removed[SHARED_KEYS];
+} worker_arg;
+
+/*
+ * Insert the own keys, remove the odd ones of them, and keep
+ * inserting and removing the shared keys against the others.
+ */
+static void *
+stress_worker(void *p){
+    worker_arg *arg = (worker_arg *) p;
+    uintptr_t base = 1000 + arg->id * KEYS_PER_THREAD, i, key;
+    unsigned int seed = arg->id + 1;
+
+    for (i = 0; i < KEYS_PER_THREAD; i++){
+	assert(cl_insert(arg->cl, (void *) (base + i)));
+
+	key = rand_r(&seed) % SHARED_KEYS + 1;
+	if (rand_r(&seed) % 2){
+	    if (cl_insert(arg->cl, (void *) key))
+		arg->inserted[key - 1]++;
+	}else{
+	    if (cl_remove_by_key(arg->cl, (void *) key) != NULL)
+		arg->removed[key - 1]++;
+	}
+	cl_search_by_key(arg->cl,
+			 (void *) (uintptr_t) (rand_r(&seed) % SHARED_KEYS + 1));
+    }
+
+    for (i = 1; i < KEYS_PER_THREAD; i += 2){
+	assert(cl_remove_by_key(arg->cl, (void *) (base + i)) ==
+	       (void *) (base + i));
+	cl_retire(arg->cl, (void *) (base + i));
+	assert(cl_search_by_key(arg->cl, (void *) (base + i - 1)) ==
+	       (void *) (base + i - 1));
+    }
+
+    return NULL;
+}
+
+static void
+test_multiple_threads(void){
+    concurrent_list *cl;
+    pthread_t threads[THREADS];
+    worker_arg args[THREADS];
+    uintptr_t i, t, last = 0;
+    int balance;
+
+    cl = cl_init(NULL, uintptr_key_match, counted_free, NULL);
+    memset(args, 0, sizeof(args));
+    for (t = 0; t < THREADS; t++){
+	args[t].cl = cl;
+	args[t].id = t;
+	pthread_create(&threads[t], NULL, stress_worker, &args[t]);
+    }
+    for (t = 0; t < THREADS; t++)
+	pthread_join(threads[t], NULL);
+
+    /* The own even keys remain */
+    for (t = 0; t < THREADS; t++)
+	for (i = 0; i < KEYS_PER_THREAD; i++)
+	    assert(cl_has_key(cl, (void *) (1000 + t * KEYS_PER_THREAD + i)) ==
+		   (i % 2 == 0));
+
+    /* A shared key exists iff it was inserted once more than removed */
+    for (i = 0; i < SHARED_KEYS; i++){
+	balance = 0;
+	for (t = 0; t < THREADS; t++)
+	    balance += args[t].inserted[i] - args[t].removed[i];
+	assert(balance == 0 || balance == 1);
+	assert(cl_has_key(cl, (void *) (i + 1)) == (balance == 1));
+    }
+
+    cl_for_each(cl, check_order, &last);
+    assert(cl_get_length(cl) >= THREADS * KEYS_PER_THREAD / 2);
+
+    cl_destroy(cl);
+}
+
+static void
+run_bundled_tests(void){
+    printf("<test single thread>\n");
+    test_single_thread();
+
+    printf("<test multiple threads>\n");
+    test_multiple_threads();
+}
+
+int
+main(void){
+
+    run_bundled_tests();
+
+    printf("All tests are done gracefully\n");
+
+    return 0;
+}
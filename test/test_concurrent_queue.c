@@ -0,0 +1,157 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "../concurrent_queue.h"
+
+#define PRODUCERS 4
+#define ITEMS_PER_PRODUCER 100000
+
+/* Number of freed data, counted by free_cb */
+static int freed;
+
+static void
+counted_free(void *data){
+    freed++;
+}
+
+static void
+test_single_thread(void){
+    concurrent_queue *q;
+    void *items[10];
+    uintptr_t i;
+
+    q = cq_init(counted_free);
+    assert(cq_is_empty(q));
+    assert(cq_dequeue(q) == NULL);
+    assert(!cq_enqueue(q, NULL));
+
+    for (i = 1; i <= 30; i++)
+	assert(cq_enqueue(q, (void *) i));
+    assert(!cq_is_empty(q));
+    assert(cq_dequeue(q) == (void *) 1);
+
+    assert(cq_dequeue_batch(q, items, 10) == 10);
+    for (i = 0; i < 10; i++)
+	assert(items[i] == (void *) (i + 2));
+
+    /* The rest goes to free_cb */
+    freed = 0;
+    cq_drain(q);
+    assert(freed == 19);
+    assert(cq_is_empty(q));
+
+    for (i = 1; i <= 5; i++)
+	cq_enqueue(q, (void *) i);
+    freed = 0;
+    cq_destroy(q);
+    assert(freed == 5);
+}
+
+typedef struct producer_arg {
+    concurrent_queue *q;
+    uintptr_t id;
+} producer_arg;
+
+/* Encode the producer and the sequence number in the data */
+#define ITEM(id, seq) ((void *) (((id) << 32) | ((seq) + 1)))
+#define ITEM_ID(item) ((uintptr_t) (item) >> 32)
+#define ITEM_SEQ(item) (((uintptr_t) (item) & 0xffffffff) - 1)
+
+static void *
+producer(void *p){
+    producer_arg *arg = (producer_arg *) p;
+    uintptr_t seq;
+
+    for (seq = 0; seq < ITEMS_PER_PRODUCER; seq++)
+	cq_enqueue(arg->q, ITEM(arg->id, seq));
+
+    return NULL;
+}
+
+/* Consume everything and check FIFO order per producer */
+static void
+consume(concurrent_queue *q, int producers){
+    uintptr_t next_seq[PRODUCERS] = { 0 }, id, total = 0;
+    void *items[64];
+    size_t count, i;
+
+    while(total < (uintptr_t) producers * ITEMS_PER_PRODUCER){
+	if (total % 2 == 0){
+	    if ((items[0] = cq_dequeue(q)) == NULL)
+		continue;
+	    count = 1;
+	}else{
+	    count = cq_dequeue_batch(q, items, 64);
+	}
+
+	for (i = 0; i < count; i++){
+	    id = ITEM_ID(items[i]);
+	    assert(id < (uintptr_t) producers);
+	    assert(ITEM_SEQ(items[i]) == next_seq[id]);
+	    next_seq[id]++;
+	}
+	total += count;
+    }
+    assert(cq_is_empty(q));
+}
+
+static void
+test_multiple_producers(void){
+    concurrent_queue *q;
+    pthread_t threads[PRODUCERS];
+    producer_arg args[PRODUCERS];
+    uintptr_t t;
+
+    q = cq_init(NULL);
+    for (t = 0; t < PRODUCERS; t++){
+	args[t].q = q;
+	args[t].id = t;
+	pthread_create(&threads[t], NULL, producer, &args[t]);
+    }
+    consume(q, PRODUCERS);
+    for (t = 0; t < PRODUCERS; t++)
+	pthread_join(threads[t], NULL);
+
+    cq_destroy(q);
+}
+
+static void
+test_single_producer(void){
+    concurrent_queue *q;
+    cq_attr attr = { .single_producer = true };
+    pthread_t thread;
+    producer_arg arg;
+
+    q = cq_init_with_attr(NULL, &attr);
+    arg.q = q;
+    arg.id = 0;
+    pthread_create(&thread, NULL, producer, &arg);
+    consume(q, 1);
+    pthread_join(thread, NULL);
+
+    cq_destroy(q);
+}
+
+static void
+run_bundled_tests(void){
+    printf("<test single thread>\n");
+    test_single_thread();
+
+    printf("<test multiple producers>\n");
+    test_multiple_producers();
+
+    printf("<test single producer>\n");
+    test_single_producer();
+}
+
+int
+main(void){
+
+    run_bundled_tests();
+
+    printf("All tests are done gracefully\n");
+
+    return 0;
+}
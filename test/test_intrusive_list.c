@@ -0,0 +1,166 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../intrusive_list.h"
+
+typedef struct connection {
+    uintptr_t fd;
+    ll_link link;
+    /* The same object in another list at the same time */
+    ll_link idle_link;
+} connection;
+
+static void *
+connection_key_access(void *data){
+    return (void *) ((connection *) data)->fd;
+}
+
+static int
+connection_key_match(void *key1, void *key2, void *metadata){
+    uintptr_t k1 = (uintptr_t) key1,
+	k2 = (uintptr_t) key2;
+
+    if (k1 < k2)
+	return -1;
+    else if (k1 == k2)
+	return 0;
+    else
+	return 1;
+}
+
+static void
+init_connections(connection *conns, int n){
+    int i;
+
+    for (i = 0; i < n; i++){
+	conns[i].fd = i + 1;
+	LL_LINK_INIT(&conns[i].link);
+	LL_LINK_INIT(&conns[i].idle_link);
+    }
+}
+
+static void
+test_basic_operations(void){
+    intrusive_list *il;
+    connection conns[10], *c;
+    int i;
+
+    init_connections(conns, 10);
+    il = il_init(offsetof(connection, link), connection_key_access,
+		 connection_key_match, NULL);
+    assert(il_is_empty(il));
+    assert(il_remove_first_data(il) == NULL);
+    assert(il_tail_remove(il) == NULL);
+
+    /* 3, 2, 1, 4, 5, ... 10 */
+    for (i = 0; i < 3; i++)
+	il_insert(il, &conns[i]);
+    for (i = 3; i < 10; i++)
+	il_tail_insert(il, &conns[i]);
+    assert(il_get_length(il) == 10);
+    assert(il_ref_index_data(il, 0) == &conns[2]);
+    assert(il_ref_index_data(il, 2) == &conns[0]);
+    assert(il_ref_index_data(il, 8) == &conns[8]);
+    assert(il_ref_index_data(il, 10) == NULL);
+
+    /* The containing object is found from its link */
+    assert(LL_CONTAINER_OF(&conns[4].link, connection, link) == &conns[4]);
+    assert(il_next(il, &conns[4]) == &conns[5]);
+    assert(il_prev(il, &conns[2]) == NULL);
+    assert(il_next(il, &conns[9]) == NULL);
+
+    /* Removal by the object pointer */
+    il_remove(il, &conns[5]);
+    assert(!il_is_linked(il, &conns[5]));
+    assert(il_next(il, &conns[4]) == &conns[6]);
+    il_insert_after(il, &conns[4], &conns[5]);
+    assert(il_next(il, &conns[4]) == &conns[5]);
+
+    assert(il_search_by_key(il, (void *) 7) == &conns[6]);
+    assert(il_has_key(il, (void *) 10));
+    assert(il_remove_by_key(il, (void *) 7) == &conns[6]);
+    assert(!il_has_key(il, (void *) 7));
+    assert(il_remove_first_data(il) == &conns[2]);
+    assert(il_tail_remove(il) == &conns[9]);
+    assert(il_get_length(il) == 7);
+
+    /* Remove every other object during the iteration */
+    i = 0;
+    il_begin_iter(il);
+    while((c = (connection *) il_get_iter_data(il)) != NULL){
+	if (i++ % 2 == 0)
+	    il_remove(il, c);
+    }
+    il_end_iter(il);
+    assert(i == 7);
+    assert(il_get_length(il) == 3);
+
+    il_remove_all(il);
+    assert(il_is_empty(il));
+    for (i = 0; i < 10; i++)
+	assert(!il_is_linked(il, &conns[i]));
+    il_destroy(il);
+}
+
+static void
+test_multiple_lists(void){
+    intrusive_list *all, *idle;
+    connection conns[100];
+    int i, pos;
+
+    init_connections(conns, 100);
+    all = il_init(offsetof(connection, link), connection_key_access,
+		  connection_key_match, NULL);
+    idle = il_init(offsetof(connection, idle_link), connection_key_access,
+		   connection_key_match, NULL);
+
+    /* Ascending order from shuffled objects */
+    for (i = 0; i < 100; i++){
+	pos = il_asc_insert(all, &conns[(i * 37) % 100]);
+	assert(pos >= 0 && pos <= i);
+	if (i % 3 == 0)
+	    il_tail_insert(idle, &conns[i]);
+    }
+    assert(il_get_length(idle) == 34);
+    for (i = 0; i < 100; i++)
+	assert(il_ref_index_data(all, i) == &conns[i]);
+
+    /* Churn: connections leave and come back */
+    for (i = 0; i < 1000; i++){
+	connection *c = &conns[(i * 7) % 100];
+
+	il_remove(all, c);
+	if (il_is_linked(idle, c))
+	    il_remove(idle, c);
+	il_asc_insert(all, c);
+    }
+    assert(il_get_length(all) == 100);
+    for (i = 0; i < 100; i++)
+	assert(il_ref_index_data(all, i) == &conns[i]);
+    /* Every connection left the idle list once */
+    assert(il_is_empty(idle));
+
+    il_destroy(all);
+    il_destroy(idle);
+}
+
+static void
+run_bundled_tests(void){
+    printf("<test basic operations>\n");
+    test_basic_operations();
+
+    printf("<test objects in multiple lists>\n");
+    test_multiple_lists();
+}
+
+int
+main(void){
+
+    run_bundled_tests();
+
+    printf("All tests are done gracefully\n");
+
+    return 0;
+}
@@ -1,8 +1,11 @@
 #include <assert.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "../linked_list.h"
 
 #define BUF_SIZE 64
@@ -64,6 +67,23 @@ employee_key_match(void *key1, void *key2, void *metadata){
 static void
 employee_free(void *data){}
 
+/*
+ * Regard employees whose ids differ only in the last digit
+ * as equal. Used to check the stability of sorting.
+ */
+static void *
+employee_group_access(void *data){
+    employee *e = (employee *) data;
+
+    return (void *) (e->id / 10);
+}
+
+/* Ignore keys_compare_metadata */
+static uint64_t
+employee_key_hash(void *key, void *metadata){
+    return (uintptr_t) key;
+}
+
 static void
 employee_print(void *data){
     employee *e = (employee *) data;
@@ -863,6 +883,1304 @@ test_key_existence(void){
     ll_destroy(ll);
 }
 
+static void
+test_node_pool(void){
+    linked_list *ll;
+    ll_attr attr = { .nodes_per_slab = 4 };
+    uintptr_t i;
+
+    ll = ll_init_with_attr(NULL, employee_key_match, NULL, NULL, &attr);
+
+    /* Fill more than one slab */
+    for (i = 0; i < 10; i++)
+	ll_tail_insert(ll, (void *) i);
+    assert(ll_get_length(ll) == 10);
+
+    /* Released nodes are recycled by the next insertions */
+    assert((uintptr_t) ll_remove_first_data(ll) == 0);
+    assert((uintptr_t) ll_remove_by_key(ll, (void *) 5) == 5);
+    assert((uintptr_t) ll_tail_remove(ll) == 9);
+    ll_insert(ll, (void *) 0);
+    assert(ll_asc_insert(ll, (void *) 5) == 5);
+    assert(ll_get_length(ll) == 9);
+
+    for (i = 0; i < 9; i++)
+	assert((uintptr_t) ll_ref_index_data(ll, i) == i);
+
+    /* The list is reusable after all slabs are gone */
+    ll_remove_all(ll);
+    assert(ll_is_empty(ll));
+    ll_insert(ll, (void *) 1);
+    assert(ll_search_by_key(ll, (void *) 1) != NULL);
+
+    ll_destroy(ll);
+}
+
+static void
+test_tail_tracking(void){
+    linked_list *ll, *dll;
+    ll_attr attr = { .doubly_linked = true, .nodes_per_slab = 8 };
+    uintptr_t i;
+
+    ll = ll_init(NULL, employee_key_match, NULL, NULL);
+    dll = ll_init_with_attr(NULL, employee_key_match, NULL, NULL, &attr);
+
+    for (i = 0; i < 10; i++){
+	ll_tail_insert(ll, (void *) i);
+	ll_tail_insert(dll, (void *) i);
+	assert((uintptr_t) ll->tail->data == i);
+	assert((uintptr_t) dll->tail->data == i);
+    }
+
+    /* Every removal path keeps the tail */
+    ll_remove_by_key(ll, (void *) 9);
+    ll_remove_by_key(dll, (void *) 9);
+    assert((uintptr_t) ll->tail->data == 8);
+    assert((uintptr_t) dll->tail->data == 8);
+    ll_index_remove(ll, ll_get_length(ll) - 1);
+    ll_index_remove(dll, ll_get_length(dll) - 1);
+    assert((uintptr_t) ll->tail->data == 7);
+    assert((uintptr_t) dll->tail->data == 7);
+    ll_asc_insert(ll, (void *) 100);
+    ll_asc_insert(dll, (void *) 100);
+    assert((uintptr_t) ll_tail_remove(ll) == 100);
+    assert((uintptr_t) ll_tail_remove(dll) == 100);
+
+    for (i = 8; i > 0; i--){
+	assert((uintptr_t) ll_tail_remove(ll) == i - 1);
+	assert((uintptr_t) ll_tail_remove(dll) == i - 1);
+    }
+    assert(ll->head == NULL && ll->tail == NULL);
+    assert(dll->head == NULL && dll->tail == NULL);
+
+    /* The tail is usable again after the list gets empty */
+    ll_insert(dll, (void *) 1);
+    ll_tail_insert(dll, (void *) 2);
+    ll_insert(dll, (void *) 0);
+    assert((uintptr_t) ll_tail_remove(dll) == 2);
+    assert((uintptr_t) ll_tail_remove(dll) == 1);
+    assert((uintptr_t) ll_tail_remove(dll) == 0);
+
+    ll_destroy(ll);
+    ll_destroy(dll);
+}
+
+/*
+ * ll_split() and ll_merge() relink the existing nodes
+ * instead of copying the data to new nodes.
+ */
+static void
+test_splice_merge_split(void){
+    linked_list *ll, *first, *merged, *other;
+    ll_attr attr = { .doubly_linked = true, .nodes_per_slab = 4 };
+    node *nodes[10], *n;
+    uintptr_t i;
+
+    ll = ll_init_with_attr(NULL, employee_key_match, NULL, NULL, &attr);
+    for (i = 0; i < 10; i++)
+	ll_tail_insert(ll, (void *) (i * 2));
+
+    /* Remember the nodes in their current order */
+    for (i = 0, n = ll->head; n != NULL; n = n->next)
+	nodes[i++] = n;
+
+    first = ll_split(ll, 4);
+    assert(ll_get_length(first) == 4);
+    assert(ll_get_length(ll) == 6);
+    assert(first->head == nodes[0] && first->tail == nodes[3]);
+    assert(ll->head == nodes[4] && ll->tail == nodes[9]);
+
+    /* Split everything, then the source list becomes empty */
+    other = ll_split(first, 4);
+    assert(ll_is_empty(first) && first->tail == NULL);
+    ll_destroy(first);
+
+    /* ll : 8, 10, ..., 18 and other : 0, 2, 4, 6 */
+    merged = ll_merge(ll, other);
+    assert(ll_get_length(merged) == 10);
+    assert(ll_is_empty(ll) && ll_is_empty(other));
+    for (i = 0, n = merged->head; n != NULL; n = n->next, i++)
+	assert(n == nodes[i]);
+    assert(merged->tail == nodes[9]);
+    ll_destroy(ll);
+    ll_destroy(other);
+
+    for (i = 10; i > 0; i--)
+	assert((uintptr_t) ll_tail_remove(merged) == (i - 1) * 2);
+
+    /* Lists with different allocators can still be merged */
+    ll = ll_init_with_attr(NULL, employee_key_match, NULL, NULL, &attr);
+    other = ll_init_with_attr(NULL, employee_key_match, NULL, NULL, &attr);
+    for (i = 0; i < 5; i++){
+	ll_tail_insert(ll, (void *) (i * 2));
+	ll_tail_insert(other, (void *) (i * 2 + 1));
+    }
+    ll_destroy(merged);
+    merged = ll_merge(other, ll);
+    ll_destroy(ll);
+    ll_destroy(other);
+    for (i = 0; i < 10; i++)
+	assert((uintptr_t) ll_ref_index_data(merged, i) == i);
+    ll_destroy(merged);
+}
+
+static void
+test_skip_index(void){
+    linked_list *ll;
+    ll_attr attr = { .skip_index = true };
+    uintptr_t i, key, expected_pos;
+    employee *e, employees[1000];
+
+    ll = ll_init_with_attr(employee_key_access,
+			   employee_key_match,
+			   employee_free, NULL, &attr);
+
+    /* Insert the keys 0 ... 999 in a scattered order */
+    for (i = 0; i < 1000; i++){
+	key = (i * 7919) % 1000;
+	employees[key].id = key;
+	snprintf(employees[key].name, BUF_SIZE, "emp%lu", key);
+
+	/* The position is the number of smaller keys so far */
+	expected_pos = 0;
+	ll_begin_iter(ll);
+	while((e = (employee *) ll_get_iter_data(ll)) != NULL)
+	    if (e->id < key)
+		expected_pos++;
+	ll_end_iter(ll);
+
+	assert(ll_asc_insert(ll, (void *) &employees[key]) == expected_pos);
+    }
+    assert(ll_get_length(ll) == 1000);
+
+    /* Note that the key 0 is regarded as NULL by the search */
+    for (i = 1; i < 1000; i++){
+	e = (employee *) ll_search_by_key(ll, (void *) i);
+	assert(e == &employees[i]);
+	assert(ll_has_key(ll, (void *) i));
+    }
+    assert(ll_search_by_key(ll, (void *) 1000) == NULL);
+    assert(ll_has_key(ll, (void *) 1000) == false);
+
+    /* Remove the odd keys */
+    for (i = 1; i < 1000; i += 2)
+	assert(ll_remove_by_key(ll, (void *) i) == &employees[i]);
+    assert(ll_remove_by_key(ll, (void *) 1) == NULL);
+    assert(ll_get_length(ll) == 500);
+    for (i = 0; i < 500; i++)
+	assert(ll_ref_index_data(ll, i) == &employees[i * 2]);
+
+    /* Equal keys are inserted after the existing ones */
+    assert(ll_asc_insert(ll, (void *) &employees[1]) == 1);
+    assert(ll_asc_insert(ll, (void *) &employees[998]) == 501);
+    assert(ll_search_by_key(ll, (void *) 998) == &employees[998]);
+
+    /* Break the order. Key operations still work by scans */
+    ll_insert(ll, (void *) &employees[999]);
+    assert(ll_search_by_key(ll, (void *) 1) == &employees[1]);
+    assert(ll_asc_insert(ll, (void *) &employees[3]) == 0);
+    assert(ll_remove_by_key(ll, (void *) 999) == &employees[999]);
+    assert(ll_has_key(ll, (void *) 3));
+
+    ll_destroy(ll);
+}
+
+/* Replacing a key between the neighbors keeps the tower usable */
+static void
+test_replace_in_order(void){
+    linked_list *ll;
+    ll_attr attr = { .skip_index = true,
+		     .key_hash_cb = employee_key_hash };
+    employee employees[1000], e505, e2, e1000, e20000, *items[2];
+    ll_stats stats;
+    uintptr_t i;
+
+    ll = ll_init_with_attr(employee_key_access, employee_key_match,
+			   NULL, NULL, &attr);
+    for (i = 0; i < 1000; i++){
+	employees[i].id = (i + 1) * 10;
+	ll_tail_insert(ll, (void *) &employees[i]);
+    }
+    assert(ll->keys_sorted);
+
+    /* 500 becomes 505, still between 490 and 510 */
+    e505.id = 505;
+    assert(ll_replace_by_key(ll, (void *) 500, (void *) &e505) ==
+	   &employees[49]);
+    assert(ll->keys_sorted);
+
+    ll_reset_stats(ll);
+    assert(ll_search_by_key(ll, (void *) 505) == &e505);
+    assert(ll_rank(ll, (void *) 505) == 49);
+    if (ll_get_stats(ll, &stats))
+	assert(stats.nodes_visited < 100);
+
+    /* Batch insertion relies on the order */
+    e2.id = 2;
+    e1000.id = 1000;
+    items[0] = &e1000;
+    items[1] = &e2;
+    assert(ll_asc_insert_batch(ll, (void **) items, 2, NULL) == 0);
+    assert(ll_ref_index_data(ll, 0) == &e2);
+    assert(ll_ref_index_data(ll, 100) == &employees[99]);
+    assert(ll_ref_index_data(ll, 101) == &e1000);
+
+    /* A key out of the neighbors breaks the order */
+    e20000.id = 20000;
+    assert(ll_replace_by_key(ll, (void *) 2, (void *) &e20000) == &e2);
+    assert(!ll->keys_sorted);
+    assert(ll_search_by_key(ll, (void *) 20000) == &e20000);
+
+    ll_destroy(ll);
+}
+
+static void
+test_hash_index(void){
+    linked_list *ll, *first, *merged;
+    ll_attr attr = { .key_hash_cb = employee_key_hash };
+    employee *e, employees[500], e1000 = { 1000, "new" };
+    uintptr_t i;
+
+    ll = ll_init_with_attr(employee_key_access,
+			   employee_key_match,
+			   employee_free, NULL, &attr);
+
+    for (i = 0; i < 500; i++){
+	employees[i].id = i;
+	snprintf(employees[i].name, BUF_SIZE, "emp%lu", i);
+	if (i % 2 == 0)
+	    ll_tail_insert(ll, (void *) &employees[i]);
+	else
+	    ll_insert(ll, (void *) &employees[i]);
+    }
+
+    for (i = 1; i < 500; i++){
+	assert(ll_search_by_key(ll, (void *) i) == &employees[i]);
+	assert(ll_has_key(ll, (void *) i));
+    }
+    assert(ll_search_by_key(ll, (void *) 500) == NULL);
+    assert(ll_has_key(ll, (void *) 500) == false);
+
+    /* Removal keeps the other entries reachable */
+    assert(ll_remove_first_data(ll) == &employees[499]);
+    ll_insert(ll, (void *) &employees[499]);
+    for (i = 3; i < 500; i += 3)
+	assert(ll_remove_by_key(ll, (void *) i) == &employees[i]);
+    for (i = 1; i < 500; i++){
+	e = (employee *) ll_search_by_key(ll, (void *) i);
+	assert(i % 3 == 0 ? e == NULL : e == &employees[i]);
+    }
+
+    /* The replaced data is found by its own key */
+    assert(ll_replace_by_key(ll, (void *) 1, (void *) &e1000) == &employees[1]);
+    assert(ll_search_by_key(ll, (void *) 1) == NULL);
+    assert(ll_search_by_key(ll, (void *) 1000) == &e1000);
+
+    /* Both parts of a split keep their own keys only */
+    first = ll_split(ll, 100);
+    for (i = 2; i < 500; i++){
+	if (i % 3 == 0)
+	    continue;
+	assert((ll_search_by_key(first, (void *) i) != NULL) !=
+	       (ll_search_by_key(ll, (void *) i) != NULL));
+    }
+
+    merged = ll_merge(first, ll);
+    assert(ll_search_by_key(merged, (void *) 1000) == &e1000);
+    assert(ll_remove_by_key(merged, (void *) 1000) == &e1000);
+    for (i = 2; i < 500; i++)
+	if (i % 3 != 0)
+	    assert(ll_remove_by_key(merged, (void *) i) == &employees[i]);
+    assert(ll_remove_by_key(merged, (void *) 0) == NULL);
+    assert(ll_get_length(merged) == 1);
+
+    ll_destroy(first);
+    ll_destroy(ll);
+    ll_destroy(merged);
+}
+
+static void
+test_merge_indexed(void){
+    linked_list *ll1, *ll2, *first, *merged;
+    ll_attr attr = { .doubly_linked = true, .nodes_per_slab = 4,
+		     .skip_index = true, .key_hash_cb = employee_key_hash };
+    employee *e, employees[400];
+    uintptr_t i;
+
+    ll1 = ll_init_with_attr(employee_key_access, employee_key_match,
+			    employee_free, NULL, &attr);
+    ll2 = ll_init_with_attr(employee_key_access, employee_key_match,
+			    employee_free, NULL, &attr);
+
+    /* ll1 : 1, 3, ..., 399 and ll2 : 2, 4, ..., 400 */
+    for (i = 0; i < 400; i++){
+	employees[i].id = i + 1;
+	snprintf(employees[i].name, BUF_SIZE, "emp%lu", i);
+	ll_asc_insert(i % 2 == 0 ? ll1 : ll2, (void *) &employees[i]);
+    }
+
+    /* Interleaved keys of lists with different allocators */
+    merged = ll_merge(ll1, ll2);
+    assert(ll_is_empty(ll1) && ll_is_empty(ll2));
+    assert(ll_search_by_key(ll1, (void *) 1) == NULL);
+    assert(ll_has_key(ll2, (void *) 2) == false);
+    assert(ll_get_length(merged) == 400);
+    for (i = 0; i < 400; i++){
+	assert(ll_ref_index_data(merged, i) == &employees[i]);
+	assert(ll_rank(merged, (void *) (i + 1)) == (int) i);
+	assert(ll_search_by_key(merged, (void *) (i + 1)) == &employees[i]);
+    }
+    assert(ll_rank(merged, (void *) 401) == 400);
+    assert(ll_has_key(merged, (void *) 401) == false);
+
+    /* Both inputs stay usable after losing their nodes */
+    ll_asc_insert(ll1, (void *) &employees[3]);
+    ll_asc_insert(ll1, (void *) &employees[1]);
+    assert(ll_rank(ll1, (void *) 4) == 1);
+    assert(ll_search_by_key(ll1, (void *) 2) == &employees[1]);
+    ll_destroy(ll1);
+    ll_destroy(ll2);
+
+    /* Merge the two halves back, sharing the allocator */
+    first = ll_split(merged, 150);
+    ll1 = ll_merge(merged, first);
+    ll_destroy(first);
+    ll_destroy(merged);
+    assert(ll_get_length(ll1) == 400);
+    for (i = 0; i < 400; i++){
+	assert(ll_rank(ll1, (void *) (i + 1)) == (int) i);
+	assert(ll_has_key(ll1, (void *) (i + 1)));
+    }
+
+    /* The previous links are intact as well */
+    for (i = 400; i > 0; i--){
+	e = (employee *) ll_tail_remove(ll1);
+	assert(e == &employees[i - 1]);
+	assert(ll_search_by_key(ll1, (void *) i) == NULL);
+    }
+    assert(ll_is_empty(ll1));
+    ll_destroy(ll1);
+}
+
+static void
+test_order_statistics(void){
+    linked_list *ll;
+    ll_attr attr = { .skip_index = true };
+    uintptr_t expected[1000], i, index;
+    int len = 0;
+
+    ll = ll_init_with_attr(NULL, employee_key_match, NULL, NULL, &attr);
+
+    /* Positional operations on a list without any key order */
+    for (i = 1; i <= 1000; i++){
+	index = (i * 31) % (len + 1);
+	ll_index_insert(ll, (void *) i, index);
+	memmove(&expected[index + 1], &expected[index],
+		(len - index) * sizeof(uintptr_t));
+	expected[index] = i;
+	len++;
+    }
+    for (i = 0; i < 1000; i++)
+	assert((uintptr_t) ll_ref_index_data(ll, i) == expected[i]);
+    assert(ll_ref_index_data(ll, 1000) == NULL);
+
+    while(len > 500){
+	index = (len * 17) % len;
+	assert((uintptr_t) ll_index_remove(ll, index) == expected[index]);
+	memmove(&expected[index], &expected[index + 1],
+		(len - index - 1) * sizeof(uintptr_t));
+	len--;
+    }
+    for (i = 0; i < 500; i++)
+	assert((uintptr_t) ll_ref_index_data(ll, i) == expected[i]);
+    assert((uintptr_t) ll_tail_remove(ll) == expected[499]);
+    ll_remove_all(ll);
+
+    /* Rank on a sorted list : 2, 4, 6, ..., 200 */
+    for (i = 100; i > 0; i--)
+	ll_asc_insert(ll, (void *) (i * 2));
+    assert(ll_rank(ll, (void *) 1) == 0);
+    assert(ll_rank(ll, (void *) 2) == 0);
+    assert(ll_rank(ll, (void *) 3) == 1);
+    assert(ll_rank(ll, (void *) 100) == 49);
+    assert(ll_rank(ll, (void *) 201) == 100);
+
+    /* Rank counts smaller keys on unsorted lists too */
+    ll_insert(ll, (void *) 300);
+    assert(ll_rank(ll, (void *) 100) == 49);
+    assert(ll_rank(ll, (void *) 301) == 101);
+
+    ll_destroy(ll);
+}
+
+/*
+ * Positional accesses resume from the last resolved node,
+ * and mutations in between keep it correct.
+ */
+static void
+test_finger_cache(void){
+    linked_list *ll;
+    uintptr_t i;
+
+    ll = ll_init(NULL, employee_key_match, NULL, NULL);
+
+    for (i = 0; i < 100; i++)
+	ll_tail_insert(ll, (void *) i);
+
+    for (i = 0; i < 100; i++)
+	assert((uintptr_t) ll_ref_index_data(ll, i) == i);
+
+    assert((uintptr_t) ll_ref_index_data(ll, 50) == 50);
+    assert(ll->finger_index == 50);
+
+    /* Insertion before the finger shifts it */
+    ll_insert(ll, (void *) 1000);
+    assert((uintptr_t) ll_ref_index_data(ll, 51) == 50);
+    ll_index_insert(ll, (void *) 2000, 10);
+    assert((uintptr_t) ll_ref_index_data(ll, 52) == 50);
+
+    /* Removal of the finger itself and the ones before it */
+    assert((uintptr_t) ll_index_remove(ll, 52) == 50);
+    assert((uintptr_t) ll_ref_index_data(ll, 52) == 51);
+    assert((uintptr_t) ll_remove_first_data(ll) == 1000);
+    assert((uintptr_t) ll_ref_index_data(ll, 51) == 51);
+    assert((uintptr_t) ll_remove_by_key(ll, (void *) 2000) == 2000);
+    assert((uintptr_t) ll_ref_index_data(ll, 50) == 51);
+
+    /* Consecutive insertions and removals around one position */
+    for (i = 0; i < 10; i++)
+	ll_index_insert(ll, (void *) (3000 + i), 20 + i);
+    for (i = 0; i < 10; i++)
+	assert((uintptr_t) ll_index_remove(ll, 20) == 3000 + i);
+
+    for (i = 0; i < 99; i++)
+	assert((uintptr_t) ll_ref_index_data(ll, i) == (i < 50 ? i : i + 1));
+
+    ll_destroy(ll);
+}
+
+static void
+test_sort(void){
+    linked_list *ll;
+    ll_attr attr = { .doubly_linked = true, .skip_index = true };
+    employee *e, *prev, employees[1000];
+    uintptr_t i;
+
+    /* Random order with many equal keys */
+    ll = ll_init_with_attr(employee_group_access, employee_key_match,
+			   employee_free, NULL, &attr);
+    for (i = 0; i < 1000; i++){
+	employees[i].id = ((i * 7919) % 100) * 10 + i / 100;
+	snprintf(employees[i].name, BUF_SIZE, "emp%lu", i);
+	ll_tail_insert(ll, (void *) &employees[i]);
+    }
+
+    ll_sort(ll);
+    assert(ll_get_length(ll) == 1000);
+
+    /* Equal keys keep their insertion order */
+    prev = NULL;
+    ll_begin_iter(ll);
+    while((e = (employee *) ll_get_iter_data(ll)) != NULL){
+	if (prev != NULL)
+	    assert(prev->id < e->id);
+	prev = e;
+    }
+    ll_end_iter(ll);
+    assert(ll->tail->data == (void *) prev);
+
+    /* The sorted list keeps working as a sorted list */
+    assert(ll_asc_insert(ll, (void *) &employees[0]) == 10);
+    assert(ll_search_by_key(ll, (void *) 50) != NULL);
+    for (i = 1000; i > 0; i--)
+	assert(ll_tail_remove(ll) != NULL);
+    assert(ll_remove_first_data(ll) == &employees[0]);
+    ll_destroy(ll);
+
+    /* Sorted, reversed and nearly sorted inputs */
+    ll = ll_init(NULL, employee_key_match, NULL, NULL);
+    for (i = 0; i < 100; i++)
+	ll_tail_insert(ll, (void *) (i + 1));
+    ll_sort(ll);
+    for (i = 0; i < 100; i++)
+	assert((uintptr_t) ll_ref_index_data(ll, i) == i + 1);
+
+    ll_remove_all(ll);
+    for (i = 0; i < 100; i++)
+	ll_insert(ll, (void *) (i + 1));
+    ll_sort(ll);
+    for (i = 0; i < 100; i++)
+	assert((uintptr_t) ll_ref_index_data(ll, i) == i + 1);
+
+    ll_index_insert(ll, (void *) 1000, 50);
+    ll_insert(ll, (void *) 500);
+    ll_sort(ll);
+    assert((uintptr_t) ll_ref_index_data(ll, 100) == 500);
+    assert((uintptr_t) ll_ref_index_data(ll, 101) == 1000);
+    assert((uintptr_t) ll->tail->data == 1000);
+
+    ll_destroy(ll);
+}
+
+static void
+test_asc_insert_batch(void){
+    linked_list *ll, *ref;
+    ll_attr attr = { .doubly_linked = true, .skip_index = true };
+    void *items[300];
+    int positions[300];
+    uintptr_t i;
+
+    ll = ll_init_with_attr(NULL, employee_key_match, NULL, NULL, &attr);
+    ref = ll_init(NULL, employee_key_match, NULL, NULL);
+    for (i = 1; i <= 100; i++){
+	ll_tail_insert(ll, (void *) (i * 3));
+	ll_tail_insert(ref, (void *) (i * 3));
+    }
+
+    /* Unsorted items with duplicates of each other and of the list */
+    for (i = 0; i < 300; i++)
+	items[i] = (void *) ((i * 7919) % 350 + 1);
+    assert(ll_asc_insert_batch(ll, items, 300, positions) == 0);
+    for (i = 0; i < 300; i++)
+	ll_asc_insert(ref, items[i]);
+
+    /* Same result as inserting one by one */
+    assert(ll_get_length(ll) == 400);
+    for (i = 0; i < 400; i++)
+	assert(ll_ref_index_data(ll, i) == ll_ref_index_data(ref, i));
+    for (i = 0; i < 300; i++)
+	assert(ll_ref_index_data(ll, positions[i]) == items[i]);
+    assert(ll_rank(ll, (void *) 350) == 399);
+
+    /* An empty batch and an empty list */
+    assert(ll_asc_insert_batch(ll, NULL, 0, NULL) == 0);
+    ll_remove_all(ll);
+    assert(ll_asc_insert_batch(ll, items, 3, positions) == 0);
+    assert(ll_get_length(ll) == 3);
+    assert(ll->tail->data == items[positions[0] == 2 ? 0 :
+				    positions[1] == 2 ? 1 : 2]);
+
+    /* Refuse a list out of order, with or without the tower */
+    ll_insert(ll, (void *) 1000);
+    assert(ll_asc_insert_batch(ll, items, 3, NULL) == -1);
+    assert(ll_get_length(ll) == 4);
+    ll_remove_all(ref);
+    ll_tail_insert(ref, (void *) 1000);
+    ll_tail_insert(ref, (void *) 1);
+    assert(ll_asc_insert_batch(ref, items, 3, NULL) == -1);
+    assert(ll_get_length(ref) == 2);
+
+    /* The order comes back with the removal of the node */
+    assert(ll_remove_first_data(ll) == (void *) 1000);
+    assert(ll_asc_insert_batch(ll, items, 3, NULL) == 0);
+    assert(ll->keys_sorted);
+    assert(ll_get_length(ll) == 6);
+
+    ll_destroy(ll);
+    ll_destroy(ref);
+}
+
+/* Calls of the callbacks below */
+static int name_access_calls, name_compare_calls;
+
+static void *
+employee_name_access(void *data){
+    name_access_calls++;
+
+    return (void *) ((employee *) data)->name;
+}
+
+static int
+employee_name_compare(void *key1, void *key2, void *metadata){
+    int cmp = strcmp((char *) key1, (char *) key2);
+
+    name_compare_calls++;
+
+    return cmp < 0 ? -1 : cmp > 0 ? 1 : 0;
+}
+
+/* First 8 bytes of the name in big-endian */
+static uint64_t
+employee_name_prefix(void *key, void *metadata){
+    unsigned char *name = (unsigned char *) key;
+    uint64_t prefix = 0;
+    int i;
+
+    for (i = 0; i < 8; i++){
+	prefix = (prefix << 8) | name[i];
+	if (name[i] == '\0'){
+	    prefix <<= 8 * (7 - i);
+	    break;
+	}
+    }
+
+    return prefix;
+}
+
+static void
+test_key_cache(void){
+    linked_list *ll;
+    ll_attr attr = { .cache_keys = true };
+    employee employees[200], *e, *prev;
+    uintptr_t i;
+
+    /* Insertions call key_access_cb only for new data */
+    ll = ll_init_with_attr(employee_name_access, employee_name_compare,
+			   NULL, NULL, &attr);
+    for (i = 0; i < 200; i++){
+	employees[i].id = i;
+	snprintf(employees[i].name, BUF_SIZE, "emp%03lu",
+		 (unsigned long) (i * 7919) % 200);
+    }
+    name_access_calls = 0;
+    for (i = 0; i < 200; i++)
+	assert(ll_asc_insert(ll, (void *) &employees[i]) >= 0);
+    assert(name_access_calls == 200);
+
+    name_access_calls = 0;
+    e = (employee *) ll_search_by_key(ll, (void *) "emp150");
+    assert(e != NULL && strcmp(e->name, "emp150") == 0);
+    assert(ll_rank(ll, (void *) "emp150") == 150);
+    assert(!ll_has_key(ll, (void *) "emp999"));
+    assert(name_access_calls == 0);
+
+    /* Replaced data gets its key cached */
+    snprintf(employees[0].name, BUF_SIZE, "emp%s", "zzz");
+    e = (employee *) ll_search_by_key(ll, (void *) "emp000");
+    assert(ll_replace_by_key(ll, (void *) "emp000",
+			     (void *) &employees[0]) == e);
+    assert(ll_search_by_key(ll, (void *) "empzzz") == &employees[0]);
+    assert(ll_search_by_key(ll, (void *) "emp000") == NULL);
+    ll_destroy(ll);
+
+    /* Most comparisons are settled by the prefixes */
+    attr.cache_keys = false;
+    attr.key_prefix_cb = employee_name_prefix;
+    attr.skip_index = true;
+    ll = ll_init_with_attr(employee_name_access, employee_name_compare,
+			   NULL, NULL, &attr);
+    assert(ll->attr.cache_keys);
+    for (i = 0; i < 200; i++)
+	snprintf(employees[i].name, BUF_SIZE, "%c%c-employee",
+		 (int) ('a' + (i * 7919) % 200 / 26),
+		 (int) ('a' + (i * 7919) % 200 % 26));
+    name_compare_calls = 0;
+    for (i = 0; i < 200; i++)
+	ll_tail_insert(ll, (void *) &employees[i]);
+    ll_sort(ll);
+    assert(name_compare_calls == 0);
+
+    prev = NULL;
+    for (i = 0; i < 200; i++){
+	e = (employee *) ll_ref_index_data(ll, i);
+	if (prev != NULL)
+	    assert(strcmp(prev->name, e->name) < 0);
+	prev = e;
+    }
+
+    assert(ll_search_by_key(ll, (void *) "zz") == NULL);
+    assert(name_compare_calls == 0);
+
+    /* Equal prefixes fall back to key_compare_cb */
+    assert(ll_search_by_key(ll, (void *) "ah-employee") != NULL);
+    assert(name_compare_calls > 0);
+    assert(ll_rank(ll, (void *) "ah-employee") == 7);
+    assert(ll_rank(ll, (void *) "ah-employeez") == 8);
+    ll_destroy(ll);
+}
+
+static void
+test_iterator_objects(void){
+    linked_list *ll;
+    ll_iter outer, inner;
+    void *p, *q;
+    uintptr_t i, pairs = 0, count = 0;
+
+    ll = ll_init(NULL, employee_key_match, NULL, NULL);
+    for (i = 1; i <= 10; i++)
+	ll_tail_insert(ll, (void *) i);
+    /* NULL data is distinguished from the end */
+    ll_tail_insert(ll, NULL);
+
+    /* Nested iterations over the same list */
+    ll_iter_begin(ll, &outer);
+    while(ll_iter_next(&outer, &p)){
+	ll_iter_begin(ll, &inner);
+	while(ll_iter_next(&inner, &q))
+	    if (p != NULL && q != NULL && (uintptr_t) p < (uintptr_t) q)
+		pairs++;
+	ll_iter_end(&inner);
+	count++;
+    }
+    ll_iter_end(&outer);
+    assert(count == 11);
+    assert(pairs == 45);
+
+    /* Key scans don't consume the embedded cursor */
+    ll_begin_iter(ll);
+    assert(ll_get_iter_data(ll) == (void *) 1);
+    assert(ll_has_key(ll, (void *) 5));
+    assert(!ll_has_key(ll, (void *) 50));
+    assert(ll_get_iter_data(ll) == (void *) 2);
+    ll_end_iter(ll);
+
+    ll_destroy(ll);
+}
+
+static void
+sum_data(void *data, void *arg){
+    atomic_fetch_add((_Atomic uintptr_t *) arg, (uintptr_t) data);
+}
+
+static void
+test_parallel_scan(void){
+    linked_list *ll;
+    ll_attr attr = { .skip_index = true };
+    employee *employees, *e;
+    _Atomic uintptr_t sum = 0;
+    uintptr_t i, n = 40000;
+
+    ll = ll_init(NULL, employee_key_match, NULL, NULL);
+    for (i = 1; i <= n; i++)
+	ll_tail_insert(ll, (void *) i);
+
+    /* Hits in any segment, and misses */
+    for (i = 1; i <= n; i += 997)
+	assert(ll_parallel_search(ll, (void *) i, 4) == (void *) i);
+    assert(ll_parallel_search(ll, (void *) n, 4) == (void *) n);
+    assert(ll_parallel_search(ll, (void *) (n + 1), 4) == NULL);
+
+    ll_parallel_for_each(ll, sum_data, (void *) &sum, 4);
+    assert(sum == n * (n + 1) / 2);
+
+    /* Segments are sampled again after modifications */
+    for (i = 0; i < 1000; i++)
+	ll_remove_first_data(ll);
+    ll_insert(ll, (void *) (n + 1));
+    assert(ll_parallel_search(ll, (void *) 500, 4) == NULL);
+    assert(ll_parallel_search(ll, (void *) (n + 1), 4) == (void *) (n + 1));
+    assert(ll_parallel_search(ll, (void *) 1001, 4) == (void *) 1001);
+    sum = 0;
+    ll_parallel_for_each(ll, sum_data, (void *) &sum, 3);
+    assert(sum == n * (n + 1) / 2 - 1000 * 1001 / 2 + n + 1);
+    ll_destroy(ll);
+
+    /* The first one of the equal keys, with a tower out of order */
+    if ((employees = (employee *) malloc(sizeof(employee) * n)) == NULL)
+	exit(-1);
+    ll = ll_init_with_attr(employee_group_access, employee_key_match,
+			   NULL, NULL, &attr);
+    for (i = 0; i < n; i++){
+	employees[i].id = (n - i) * 10 % 20000 + 10;
+	ll_tail_insert(ll, (void *) &employees[i]);
+    }
+    for (i = 1; i <= 2000; i += 111){
+	e = (employee *) ll_parallel_search(ll, (void *) i, 4);
+	assert(e == ll_search_by_key(ll, (void *) i));
+    }
+    ll_destroy(ll);
+    free(employees);
+}
+
+static void
+test_parallel_sort(void){
+    linked_list *ll, *ref;
+    ll_attr attr = { .doubly_linked = true, .skip_index = true };
+    employee *employees;
+    uintptr_t i, n = 50000;
+    int nthreads;
+
+    if ((employees = (employee *) malloc(sizeof(employee) * n)) == NULL)
+	exit(-1);
+    for (i = 0; i < n; i++)
+	employees[i].id = (i * 7919) % n;
+
+    for (nthreads = 2; nthreads <= 8; nthreads *= 2){
+	ll = ll_init_with_attr(employee_group_access, employee_key_match,
+			       NULL, NULL, &attr);
+	ref = ll_init(employee_group_access, employee_key_match, NULL, NULL);
+	for (i = 0; i < n; i++){
+	    ll_tail_insert(ll, (void *) &employees[i]);
+	    ll_tail_insert(ref, (void *) &employees[i]);
+	}
+
+	/* Same stable order as ll_sort() */
+	ll_parallel_sort(ll, nthreads);
+	ll_sort(ref);
+	assert(ll_get_length(ll) == n);
+	for (i = 0; i < n; i++)
+	    assert(ll_ref_index_data(ll, i) == ll_ref_index_data(ref, i));
+	assert(ll->tail->data == ref->tail->data);
+	assert(ll_tail_remove(ll) == ll_tail_remove(ref));
+
+	/* Keeps working as a sorted list */
+	assert(ll_rank(ll, (void *) 100) == 1000);
+	ll_destroy(ll);
+	ll_destroy(ref);
+    }
+
+    free(employees);
+}
+
+/* Number of employees freed by counted_employee_free() */
+static int freed_employees;
+
+static void
+counted_employee_free(void *data){
+    freed_employees++;
+}
+
+static bool
+employee_id_divisible(void *data, void *ctx){
+    return ((employee *) data)->id % (uintptr_t) ctx == 0;
+}
+
+static void
+test_predicate_removal(void){
+    linked_list *ll, *removed;
+    ll_attr attr = { .skip_index = true, .key_hash_cb = employee_key_hash };
+    employee employees[1000];
+    uintptr_t i;
+
+    ll = ll_init_with_attr(employee_key_access, employee_key_match,
+			   counted_employee_free, NULL, &attr);
+    for (i = 0; i < 1000; i++){
+	employees[i].id = i;
+	ll_asc_insert(ll, (void *) &employees[i]);
+    }
+
+    /* Removed data goes to free_cb */
+    freed_employees = 0;
+    assert(ll_remove_if(ll, employee_id_divisible, (void *) 3, NULL) == 334);
+    assert(freed_employees == 334);
+    assert(ll_get_length(ll) == 666);
+    assert(ll_remove_if(ll, employee_id_divisible, (void *) 3, NULL) == 0);
+
+    /* Or it's handed back in order */
+    removed = ll_init(employee_key_access, employee_key_match, NULL, NULL);
+    assert(ll_retain_if(ll, employee_id_divisible, (void *) 2, removed) == 333);
+    assert(freed_employees == 334);
+    assert(ll_get_length(ll) == 333);
+    for (i = 0; i < 333; i++){
+	assert(((employee *) ll_ref_index_data(removed, i))->id ==
+	       (i / 2) * 6 + (i % 2 == 0 ? 1 : 5));
+	assert(((employee *) ll_ref_index_data(ll, i))->id ==
+	       (i / 2) * 6 + (i % 2 == 0 ? 2 : 4));
+    }
+    assert(((employee *) ll->tail->data)->id == 998);
+
+    /* The indexes follow the new chain */
+    for (i = 0; i < 1000; i++)
+	assert(ll_search_by_key(ll, (void *) i) ==
+	       (i % 2 == 0 && i % 3 != 0 ? &employees[i] : NULL));
+    assert(ll_rank(ll, (void *) 500) == 166);
+    ll_asc_insert(ll, (void *) &employees[3]);
+    assert(ll_ref_index_data(ll, 1) == &employees[3]);
+
+    /* Removing everything leaves an empty list */
+    assert(ll_remove_if(ll, employee_id_divisible, (void *) 1, removed) == 334);
+    assert(ll_is_empty(ll) && ll->tail == NULL);
+    assert(ll_get_length(removed) == 667);
+    ll_tail_insert(ll, (void *) &employees[7]);
+    assert(ll->head == ll->tail);
+
+    ll_destroy(removed);
+    ll_destroy(ll);
+}
+
+/*
+ * Counters are checked only when the library is built with
+ * LL_STATS (the lls_test program).
+ */
+static void
+test_stats(void){
+    linked_list *ll, *cached, *skip;
+    ll_attr cached_attr = { .cache_keys = true },
+	skip_attr = { .skip_index = true };
+    employee employees[100];
+    ll_stats stats;
+    uintptr_t i;
+
+    ll = ll_init(employee_key_access, employee_key_match, NULL, NULL);
+    for (i = 0; i < 100; i++){
+	employees[i].id = i;
+	ll_tail_insert(ll, (void *) &employees[i]);
+    }
+
+    if (!ll_get_stats(ll, &stats)){
+	assert(stats.node_allocs == 0 && stats.nodes_visited == 0);
+	ll_destroy(ll);
+	return;
+    }
+    assert(stats.node_allocs == 100);
+    assert(stats.nodes_visited == 0 && stats.key_compare_calls == 0);
+
+    /* A hit at the index 49 visits 50 nodes */
+    ll_reset_stats(ll);
+    assert(ll_search_by_key(ll, (void *) 49) == &employees[49]);
+    ll_get_stats(ll, &stats);
+    assert(stats.nodes_visited == 50 && stats.longest_scan == 50);
+    assert(stats.key_compare_calls == 50 && stats.key_access_calls == 50);
+
+    /* A miss visits all */
+    assert(ll_search_by_key(ll, (void *) 100) == NULL);
+    ll_get_stats(ll, &stats);
+    assert(stats.nodes_visited == 150 && stats.longest_scan == 100);
+
+    assert(ll_remove_by_key(ll, (void *) 1) == &employees[1]);
+    ll_get_stats(ll, &stats);
+    assert(stats.nodes_visited == 152 && stats.node_frees == 1);
+    ll_destroy(ll);
+
+    /* Sorted insertions at the end scan the whole list every time */
+    ll = ll_init(employee_key_access, employee_key_match, NULL, NULL);
+    cached = ll_init_with_attr(employee_key_access, employee_key_match,
+			       NULL, NULL, &cached_attr);
+    skip = ll_init_with_attr(employee_key_access, employee_key_match,
+			     NULL, NULL, &skip_attr);
+    for (i = 0; i < 100; i++){
+	ll_asc_insert(ll, (void *) &employees[i]);
+	ll_asc_insert(cached, (void *) &employees[i]);
+	ll_asc_insert(skip, (void *) &employees[i]);
+    }
+
+    ll_get_stats(ll, &stats);
+    assert(stats.nodes_visited == 99 * 100 / 2);
+    assert(stats.longest_scan == 99);
+    assert(stats.key_compare_calls == 99 * 100 / 2);
+    assert(stats.key_access_calls == 99 * 100 / 2 + 100);
+
+    /* Keys are accessed only once per node when they are cached */
+    ll_get_stats(cached, &stats);
+    assert(stats.nodes_visited == 99 * 100 / 2);
+    assert(stats.key_access_calls == 100);
+
+    /* The tower shortens the scans */
+    ll_get_stats(skip, &stats);
+    assert(stats.longest_scan < 50);
+    assert(stats.nodes_visited < 99 * 100 / 2);
+
+    ll_destroy(ll);
+    ll_destroy(cached);
+    ll_destroy(skip);
+}
+
+/* Records of the trace hook */
+typedef struct trace_record {
+    int calls[LL_OP_COUNT];
+    linked_list *last_list;
+    uint64_t last_visited;
+} trace_record;
+
+static void
+record_trace(ll_op op, linked_list *ll, uint64_t visited, uint64_t ns,
+	     void *arg){
+    trace_record *record = (trace_record *) arg;
+
+    record->calls[op]++;
+    record->last_list = ll;
+    record->last_visited = visited;
+}
+
+static void
+test_tracing(void){
+    linked_list *ll, *first, *merged;
+    ll_attr attr = { .latency_histograms = true };
+    employee employees[200];
+    trace_record record;
+    ll_latency latency;
+    ll_stats stats;
+    uintptr_t i;
+    bool counted;
+
+    /* No histograms by default */
+    ll = ll_init(employee_key_access, employee_key_match, NULL, NULL);
+    assert(!ll_get_latency(ll, LL_OP_SEARCH_BY_KEY, &latency));
+    ll_destroy(ll);
+
+    memset(&record, 0, sizeof(record));
+    ll_set_trace_hook(record_trace, &record);
+
+    ll = ll_init_with_attr(employee_key_access, employee_key_match,
+			   NULL, NULL, &attr);
+    counted = ll_get_stats(ll, &stats);
+    for (i = 0; i < 200; i++){
+	employees[i].id = i;
+	ll_asc_insert(ll, (void *) &employees[i]);
+    }
+    assert(record.calls[LL_OP_ASC_INSERT] == 200);
+    assert(record.last_list == ll);
+    assert(record.last_visited == (counted ? 199 : 0));
+
+    /* Only the traced operations are reported */
+    for (i = 1; i <= 100; i++)
+	assert(ll_search_by_key(ll, (void *) i) == &employees[i]);
+    assert(ll_has_key(ll, (void *) 1));
+    assert(ll_remove_by_key(ll, (void *) 100) == &employees[100]);
+    assert(record.calls[LL_OP_SEARCH_BY_KEY] == 100);
+    assert(record.calls[LL_OP_REMOVE_BY_KEY] == 1);
+    assert(record.last_visited == (counted ? 101 : 0));
+
+    assert(ll_get_latency(ll, LL_OP_SEARCH_BY_KEY, &latency));
+    assert(latency.count == 100);
+    assert(ll_latency_percentile(&latency, 50) <=
+	   ll_latency_percentile(&latency, 99));
+    assert(ll_latency_percentile(&latency, 100) == latency.max_ns);
+    assert(latency.total_ns >= latency.max_ns);
+
+    /* The merged list is reported and inherits the histograms */
+    first = ll_split(ll, 50);
+    assert(record.calls[LL_OP_SPLIT] == 1 && record.last_list == ll);
+    merged = ll_merge(first, ll);
+    assert(record.calls[LL_OP_MERGE] == 1 && record.last_list == merged);
+    assert(ll_get_latency(merged, LL_OP_MERGE, &latency));
+    assert(latency.count == 1);
+
+    ll_reset_latency(merged);
+    assert(ll_get_latency(merged, LL_OP_MERGE, &latency));
+    assert(latency.count == 0 && ll_latency_percentile(&latency, 50) == 0);
+
+    /* Removing the hook stops the reports */
+    ll_set_trace_hook(NULL, NULL);
+    ll_search_by_key(merged, (void *) 1);
+    assert(record.calls[LL_OP_SEARCH_BY_KEY] == 100);
+    assert(ll_get_latency(merged, LL_OP_SEARCH_BY_KEY, &latency));
+    assert(latency.count == 1);
+
+    ll_destroy(first);
+    ll_destroy(ll);
+    ll_destroy(merged);
+}
+
+/* Prefetching doesn't change any result */
+static void
+test_prefetch(void){
+    ll_attr attrs[] = { { .prefetch_distance = 1 },
+			{ .prefetch_distance = 4, .cache_keys = true },
+			{ .prefetch_distance = 100 } };
+    linked_list *ll;
+    employee employees[300];
+    ll_iter iter;
+    void *data;
+    uintptr_t i, a;
+
+    for (i = 0; i < 300; i++)
+	employees[i].id = (i * 7) % 300;
+
+    for (a = 0; a < sizeof(attrs) / sizeof(attrs[0]); a++){
+	ll = ll_init_with_attr(employee_key_access, employee_key_match,
+			       NULL, NULL, &attrs[a]);
+	assert(ll->attr.prefetch_distance <= LL_PREFETCH_MAX_DISTANCE);
+
+	for (i = 0; i < 300; i++)
+	    ll_asc_insert(ll, (void *) &employees[i]);
+
+	/* Stops prefetching at the end of the list */
+	i = 0;
+	ll_iter_begin(ll, &iter);
+	while(ll_iter_next(&iter, &data))
+	    assert(((employee *) data)->id == i++);
+	ll_iter_end(&iter);
+	assert(i == 300);
+
+	for (i = 1; i < 300; i++){
+	    assert(((employee *) ll_search_by_key(ll, (void *) i))->id == i);
+	    assert(ll_rank(ll, (void *) i) == i);
+	}
+	assert(ll_search_by_key(ll, (void *) 300) == NULL);
+	assert(ll_has_key(ll, (void *) 299));
+
+	for (i = 1; i < 300; i += 2)
+	    assert(((employee *) ll_remove_by_key(ll, (void *) i))->id == i);
+	assert(ll_get_length(ll) == 150);
+	assert(ll_rank(ll, (void *) 299) == 150);
+
+	ll_destroy(ll);
+    }
+}
+
+/* Zero bytes appended to each record by encode_employee() */
+static size_t record_padding;
+
+/* Id which decode_employee() fails for */
+static uintptr_t broken_id;
+
+static size_t
+encode_employee(void *data, void *buf, size_t size, void *arg){
+    employee *e = (employee *) data;
+    size_t len = sizeof(e->id) + strlen(e->name) + record_padding;
+
+    if (len <= size){
+	memcpy(buf, &e->id, sizeof(e->id));
+	memcpy((char *) buf + sizeof(e->id), e->name, strlen(e->name));
+	memset((char *) buf + len - record_padding, 0, record_padding);
+    }
+
+    return len;
+}
+
+static void *
+decode_employee(const void *buf, size_t len, void *arg){
+    employee *e;
+    size_t name_len;
+
+    assert(len >= sizeof(e->id) + record_padding);
+    name_len = len - sizeof(e->id) - record_padding;
+    assert(name_len < BUF_SIZE);
+
+    if ((e = (employee *) malloc(sizeof(employee))) == NULL){
+	perror("malloc");
+	exit(-1);
+    }
+    memcpy(&e->id, buf, sizeof(e->id));
+    memcpy(e->name, (const char *) buf + sizeof(e->id), name_len);
+    e->name[name_len] = '\0';
+
+    if (e->id == broken_id){
+	free(e);
+	return NULL;
+    }
+
+    return e;
+}
+
+/* Save 'll' into a temporary file and return its descriptor at the start */
+static int
+save_list(linked_list *ll){
+    FILE *fp;
+    int fd;
+
+    if ((fp = tmpfile()) == NULL){
+	perror("tmpfile");
+	exit(-1);
+    }
+    fd = dup(fileno(fp));
+    fclose(fp);
+
+    assert(ll_serialize(ll, fd, encode_employee, NULL) == 0);
+    assert(lseek(fd, 0, SEEK_SET) == 0);
+
+    return fd;
+}
+
+/* Data and order of two lists are the same */
+static void
+check_same_employees(linked_list *ll1, linked_list *ll2){
+    employee *e1, *e2;
+    int i;
+
+    assert(ll_get_length(ll1) == ll_get_length(ll2));
+    for (i = 0; i < ll_get_length(ll1); i++){
+	e1 = (employee *) ll_ref_index_data(ll1, i);
+	e2 = (employee *) ll_ref_index_data(ll2, i);
+	assert(e1->id == e2->id);
+	assert(strcmp(e1->name, e2->name) == 0);
+    }
+}
+
+static void
+test_serialization(void){
+    ll_attr attr = { .doubly_linked = true, .nodes_per_slab = 64,
+		     .skip_index = true, .key_hash_cb = employee_key_hash };
+    linked_list *ll, *loaded;
+    employee employees[1000], *e;
+    uintptr_t i;
+    int fd;
+
+    broken_id = 0;
+    record_padding = 0;
+    for (i = 0; i < 1000; i++){
+	employees[i].id = (i * 7) % 1000 + 1;
+	snprintf(employees[i].name, BUF_SIZE, "emp%lu", (unsigned long) i);
+    }
+
+    /* Sorted list is loaded with its indexes */
+    ll = ll_init_with_attr(employee_key_access, employee_key_match,
+			   NULL, NULL, &attr);
+    for (i = 0; i < 1000; i++)
+	ll_asc_insert(ll, (void *) &employees[i]);
+    fd = save_list(ll);
+    loaded = ll_init_with_attr(employee_key_access, employee_key_match,
+			       free, NULL, &attr);
+    assert(ll_deserialize(fd, decode_employee, NULL, loaded) == 0);
+    close(fd);
+    check_same_employees(ll, loaded);
+    assert(loaded->keys_sorted);
+    assert(((employee *) ll_search_by_key(loaded, (void *) 500))->id == 500);
+    assert(ll_rank(loaded, (void *) 500) == 499);
+    e = (employee *) ll_remove_by_key(loaded, (void *) 1000);
+    assert(e->id == 1000);
+    assert(ll_asc_insert(loaded, (void *) e) == 999);
+    assert(((employee *) ll_tail_remove(loaded))->id == 1000);
+    free(e);
+
+    /* Not into a list with data */
+    fd = save_list(ll);
+    assert(ll_deserialize(fd, decode_employee, NULL, loaded) == -1);
+    assert(ll_get_length(loaded) == 999);
+    close(fd);
+    ll_destroy(loaded);
+
+    /* Unsorted list keeps its order */
+    ll_remove_all(ll);
+    for (i = 0; i < 1000; i++)
+	ll_tail_insert(ll, (void *) &employees[i]);
+    fd = save_list(ll);
+    loaded = ll_init_with_attr(employee_key_access, employee_key_match,
+			       free, NULL, &attr);
+    assert(ll_deserialize(fd, decode_employee, NULL, loaded) == 0);
+    close(fd);
+    check_same_employees(ll, loaded);
+    assert(!loaded->keys_sorted);
+    assert(((employee *) ll_search_by_key(loaded, (void *) 77))->id == 77);
+    ll_destroy(loaded);
+
+    /* Records longer than the I/O buffer */
+    ll_destroy(ll);
+    ll = ll_init(employee_key_access, employee_key_match, NULL, NULL);
+    for (i = 0; i < 5; i++)
+	ll_asc_insert(ll, (void *) &employees[i]);
+    record_padding = 3 << 20;
+    fd = save_list(ll);
+    loaded = ll_init(employee_key_access, employee_key_match, free, NULL);
+    assert(ll_deserialize(fd, decode_employee, NULL, loaded) == 0);
+    close(fd);
+    check_same_employees(ll, loaded);
+    ll_destroy(loaded);
+    record_padding = 0;
+
+    /* Failure of decoding leaves the list empty */
+    fd = save_list(ll);
+    broken_id = employees[3].id;
+    loaded = ll_init(employee_key_access, employee_key_match, free, NULL);
+    assert(ll_deserialize(fd, decode_employee, NULL, loaded) == -1);
+    assert(ll_is_empty(loaded));
+    broken_id = 0;
+
+    /* Truncated file */
+    assert(ftruncate(fd, lseek(fd, 0, SEEK_END) - 1) == 0);
+    assert(lseek(fd, 0, SEEK_SET) == 0);
+    assert(ll_deserialize(fd, decode_employee, NULL, loaded) == -1);
+    assert(ll_is_empty(loaded));
+
+    /* Broken magic */
+    assert(lseek(fd, 0, SEEK_SET) == 0);
+    assert(write(fd, "XXXX", 4) == 4);
+    assert(lseek(fd, 0, SEEK_SET) == 0);
+    assert(ll_deserialize(fd, decode_employee, NULL, loaded) == -1);
+    close(fd);
+
+    /* Empty list */
+    ll_remove_all(ll);
+    fd = save_list(ll);
+    assert(ll_deserialize(fd, decode_employee, NULL, loaded) == 0);
+    assert(ll_is_empty(loaded));
+    close(fd);
+
+    ll_destroy(loaded);
+    ll_destroy(ll);
+}
+
 static void
 run_bundled_tests(void){
     printf("<test basic operations>\n");
@@ -929,6 +2247,66 @@ run_bundled_tests(void){
 
     printf("<test key existence>\n");
     test_key_existence();
+
+    printf("<test node pool>\n");
+    test_node_pool();
+
+    printf("<test tail tracking>\n");
+    test_tail_tracking();
+
+    printf("<test merge and split by relinking nodes>\n");
+    test_splice_merge_split();
+
+    printf("<test skip-list index>\n");
+    test_skip_index();
+
+    printf("<test replace in order>\n");
+    test_replace_in_order();
+
+    printf("<test hash index>\n");
+    test_hash_index();
+
+    printf("<test merge with indexes>\n");
+    test_merge_indexed();
+
+    printf("<test order statistics>\n");
+    test_order_statistics();
+
+    printf("<test finger cache>\n");
+    test_finger_cache();
+
+    printf("<test sort>\n");
+    test_sort();
+
+    printf("<test ascending batch insertion>\n");
+    test_asc_insert_batch();
+
+    printf("<test key cache>\n");
+    test_key_cache();
+
+    printf("<test iterator objects>\n");
+    test_iterator_objects();
+
+    printf("<test parallel scan>\n");
+    test_parallel_scan();
+
+    printf("<test parallel sort>\n");
+    test_parallel_sort();
+
+    printf("<test predicate removal>\n");
+    test_predicate_removal();
+
+    printf("<test stats>\n");
+    test_stats();
+
+    printf("<test tracing>\n");
+    test_tracing();
+
+    printf("<test prefetch>\n");
+    test_prefetch();
+
+    printf("<test serialization>\n");
+    test_serialization();
 }
 
 int
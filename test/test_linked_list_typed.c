@@ -0,0 +1,127 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../linked_list_typed.h"
+
+#define BUF_SIZE 64
+typedef struct employee {
+    int id;
+    char name[BUF_SIZE];
+} employee;
+
+#define EMPLOYEE_ID(e) ((e)->id)
+
+LL_DEFINE(int_list, int, int, LL_VALUE_AS_KEY, LL_COMPARE_NUMBERS)
+LL_DEFINE(emp_list, employee, int, EMPLOYEE_ID, LL_COMPARE_NUMBERS)
+
+/* Names as the keys, compared by a function */
+static inline const char *
+employee_name(const employee *e){
+    return e->name;
+}
+
+LL_DEFINE(name_list, employee, const char *, employee_name, strcmp)
+
+static void
+test_int_list(void){
+    int_list l, first, merged;
+    int i, value, *p;
+
+    int_list_init(&l);
+    assert(int_list_is_empty(&l));
+    for (i = 0; i < 100; i++)
+	assert(int_list_asc_insert(&l, (i * 37) % 100) >= 0);
+    assert(int_list_get_length(&l) == 100);
+    for (i = 0; i < 100; i++)
+	assert(*int_list_ref_index_data(&l, i) == i);
+    assert(int_list_ref_index_data(&l, 100) == NULL);
+
+    /* Equal keys go after the existing ones */
+    assert(int_list_asc_insert(&l, 50) == 51);
+    assert(int_list_remove_by_key(&l, 50, &value) && value == 50);
+    assert(int_list_has_key(&l, 50));
+    assert(int_list_remove_by_key(&l, 50, NULL));
+    assert(!int_list_has_key(&l, 50));
+    assert(int_list_search_by_key(&l, 99) == &l.tail->value);
+
+    int_list_insert(&l, 50);
+    assert(int_list_remove_first_data(&l, &value) && value == 50);
+
+    /* Split and merge back */
+    int_list_init(&first);
+    assert(!int_list_split(&l, 0, &first));
+    assert(int_list_split(&l, 40, &first));
+    assert(int_list_get_length(&first) == 40);
+    assert(int_list_get_length(&l) == 59);
+    assert(first.tail->value == 39 && l.head->value == 40);
+
+    int_list_init(&merged);
+    int_list_merge(&l, &first, &merged);
+    assert(int_list_is_empty(&l) && int_list_is_empty(&first));
+
+    i = 0;
+    int_list_begin_iter(&merged);
+    while((p = int_list_get_iter_data(&merged)) != NULL){
+	if (i == 50)
+	    i++;
+	assert(*p == i++);
+    }
+    int_list_end_iter(&merged);
+    assert(i == 100);
+
+    int_list_destroy(&merged);
+}
+
+static void
+test_struct_list(void){
+    emp_list l;
+    name_list names;
+    employee e, *hit;
+    int i;
+
+    emp_list_init(&l);
+    name_list_init(&names);
+    for (i = 0; i < 10; i++){
+	e.id = 10 - i;
+	snprintf(e.name, BUF_SIZE, "emp%d", i);
+	emp_list_asc_insert(&l, e);
+	name_list_asc_insert(&names, e);
+    }
+
+    /* Values are stored by value */
+    hit = emp_list_search_by_key(&l, 3);
+    assert(hit != NULL && strcmp(hit->name, "emp7") == 0);
+    assert(emp_list_search_by_key(&l, 11) == NULL);
+    assert(emp_list_ref_index_data(&l, 0)->id == 1);
+
+    hit = name_list_search_by_key(&names, "emp7");
+    assert(hit != NULL && hit->id == 3);
+    assert(name_list_ref_index_data(&names, 0)->id == 10);
+
+    assert(emp_list_remove_by_key(&l, 3, &e) && strcmp(e.name, "emp7") == 0);
+    assert(emp_list_get_length(&l) == 9);
+
+    emp_list_destroy(&l);
+    name_list_destroy(&names);
+}
+
+static void
+run_bundled_tests(void){
+    printf("<test integer list>\n");
+    test_int_list();
+
+    printf("<test structure list>\n");
+    test_struct_list();
+}
+
+int
+main(void){
+
+    run_bundled_tests();
+
+    printf("All tests are done gracefully\n");
+
+    return 0;
+}
@@ -0,0 +1,379 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../unrolled_list.h"
+
+#define BUF_SIZE 64
+typedef struct employee {
+    uintptr_t id;
+    char name[BUF_SIZE];
+} employee;
+
+/* Calls of employee_key_access() */
+static int key_access_calls;
+
+static void *
+employee_key_access(void *data){
+    assert(data != NULL);
+
+    key_access_calls++;
+
+    return (void *) ((employee *) data)->id;
+}
+
+static int
+uintptr_key_match(void *key1, void *key2, void *metadata){
+    uintptr_t k1 = (uintptr_t) key1,
+	k2 = (uintptr_t) key2;
+
+    if (k1 < k2)
+	return -1;
+    else if (k1 == k2)
+	return 0;
+    else
+	return 1;
+}
+
+static int
+intptr_key_match(void *key1, void *key2, void *metadata){
+    intptr_t k1 = (intptr_t) key1,
+	k2 = (intptr_t) key2;
+
+    if (k1 < k2)
+	return -1;
+    else if (k1 == k2)
+	return 0;
+    else
+	return 1;
+}
+
+/* Check every element and the block invariants against 'ref' */
+static void
+check_elements(unrolled_list *ul, uintptr_t *ref, int n){
+    ul_block *b;
+    uintptr_t count = 0;
+    int i;
+
+    assert(ul_get_length(ul) == n);
+    for (b = ul->head; b != NULL; b = b->next){
+	assert(b->count > 0 && b->count <= ul->block_capacity);
+	assert(b->next != NULL || ul->tail == b);
+	assert(b->next == NULL || b->next->prev == b);
+	count += b->count;
+    }
+    assert(count == (uintptr_t) n);
+
+    for (i = 0; i < n; i++)
+	assert((uintptr_t) ul_ref_index_data(ul, i) == ref[i]);
+}
+
+static void
+test_basic_operations(void){
+    unrolled_list *ul;
+    uintptr_t i, ref[100];
+    void *p;
+
+    ul = ul_init(NULL, uintptr_key_match, NULL, NULL);
+    assert(ul_is_empty(ul));
+    assert(ul_remove_first_data(ul) == NULL);
+    assert(ul_tail_remove(ul) == NULL);
+
+    /* 3, 2, 1, 4, 5, ... spanning several blocks */
+    for (i = 1; i <= 3; i++)
+	ul_insert(ul, (void *) i);
+    for (i = 4; i <= 100; i++)
+	ul_tail_insert(ul, (void *) i);
+    ref[0] = 3; ref[1] = 2; ref[2] = 1;
+    for (i = 3; i < 100; i++)
+	ref[i] = i + 1;
+    check_elements(ul, ref, 100);
+
+    assert(ul_has_key(ul, (void *) 50));
+    assert(!ul_has_key(ul, (void *) 500));
+    assert(ul_search_by_key(ul, (void *) 77) == (void *) 77);
+    assert(ul_rank(ul, (void *) 50) == 49);
+
+    assert(ul_remove_first_data(ul) == (void *) 3);
+    assert(ul_tail_remove(ul) == (void *) 100);
+    assert(ul_remove_by_key(ul, (void *) 60) == (void *) 60);
+    assert(ul_remove_by_key(ul, (void *) 60) == NULL);
+    assert(ul_replace_by_key(ul, (void *) 2, (void *) 200) == (void *) 2);
+    assert(ul_get_length(ul) == 97);
+    assert(ul_ref_index_data(ul, 0) == (void *) 200);
+    assert(ul_ref_index_data(ul, 97) == NULL);
+
+    /* Iteration visits every element once */
+    i = 0;
+    ul_begin_iter(ul);
+    while((p = ul_get_iter_data(ul)) != NULL)
+	i++;
+    ul_end_iter(ul);
+    assert(i == 97);
+
+    ul_remove_all(ul);
+    assert(ul_is_empty(ul));
+    ul_destroy(ul);
+}
+
+/* Positional operations at random positions, compared with an array */
+static void
+test_positional_operations(void){
+    unrolled_list *ul;
+    ul_attr attr = { .block_capacity = 4 };
+    uintptr_t ref[2000];
+    int n = 0, i, op, index;
+
+    ul = ul_init_with_attr(NULL, uintptr_key_match, NULL, NULL, &attr);
+    srand(1);
+    for (i = 0; i < 20000; i++){
+	op = rand() % 4;
+	if (op <= 1 && n < 2000){
+	    index = rand() % (n + 1);
+	    ul_index_insert(ul, (void *) (uintptr_t) (i + 1), index);
+	    memmove(&ref[index + 1], &ref[index],
+		    (n - index) * sizeof(uintptr_t));
+	    ref[index] = i + 1;
+	    n++;
+	}else if (op == 2 && n > 0){
+	    index = rand() % n;
+	    assert((uintptr_t) ul_index_remove(ul, index) == ref[index]);
+	    memmove(&ref[index], &ref[index + 1],
+		    (n - index - 1) * sizeof(uintptr_t));
+	    n--;
+	}else if (n > 0){
+	    index = rand() % n;
+	    assert((uintptr_t) ul_ref_index_data(ul, index) == ref[index]);
+	}
+	if (i % 1000 == 0)
+	    check_elements(ul, ref, n);
+    }
+    check_elements(ul, ref, n);
+
+    /* Out of range */
+    ul_index_insert(ul, (void *) 1, n + 1);
+    assert(ul_get_length(ul) == n);
+    assert(ul_index_remove(ul, n) == NULL);
+
+    ul_destroy(ul);
+}
+
+/* The smallest blocks still split into non-empty halves */
+static void
+test_small_blocks(void){
+    unrolled_list *ul;
+    ul_attr attr;
+    uintptr_t ref[50];
+    unsigned int capacity;
+    int i;
+
+    for (capacity = 1; capacity <= 2; capacity++){
+	attr = (ul_attr) { .block_capacity = capacity };
+	ul = ul_init_with_attr(NULL, uintptr_key_match, NULL, NULL, &attr);
+	assert(ul->block_capacity == UL_MIN_BLOCK_CAPACITY);
+
+	/* 2, 4, ..., 40, then the odd numbers in the middle */
+	for (i = 0; i < 20; i++)
+	    ul_tail_insert(ul, (void *) (uintptr_t) (2 * i + 2));
+	for (i = 0; i < 20; i++)
+	    ul_index_insert(ul, (void *) (uintptr_t) (2 * i + 1), 2 * i);
+	ul_insert(ul, (void *) 100);
+	assert(ul_remove_first_data(ul) == (void *) 100);
+	for (i = 0; i < 40; i++)
+	    ref[i] = i + 1;
+	check_elements(ul, ref, 40);
+
+	assert(ul_asc_insert(ul, (void *) 41) == 40);
+	assert(ul_remove_by_key(ul, (void *) 41) == (void *) 41);
+	for (i = 0; i < 20; i++)
+	    assert(ul_remove_by_key(ul, (void *) (uintptr_t) (2 * i + 1)) ==
+		   (void *) (uintptr_t) (2 * i + 1));
+	for (i = 0; i < 20; i++)
+	    ref[i] = 2 * i + 2;
+	check_elements(ul, ref, 20);
+
+	ul_destroy(ul);
+    }
+}
+
+static void
+test_key_cache(void){
+    unrolled_list *ul;
+    ul_attr attr = { .block_capacity = 8, .cache_keys = true };
+    employee employees[100], *e, *prev;
+    uintptr_t i;
+
+    ul = ul_init_with_attr(employee_key_access, uintptr_key_match,
+			   NULL, NULL, &attr);
+    for (i = 0; i < 100; i++){
+	employees[i].id = (i * 37) % 100 + 1;
+	snprintf(employees[i].name, BUF_SIZE, "emp%lu", (unsigned long) i);
+    }
+
+    /* Keys are extracted only once per insertion */
+    key_access_calls = 0;
+    for (i = 0; i < 100; i++)
+	assert(ul_asc_insert(ul, (void *) &employees[i]) >= 0);
+    assert(key_access_calls == 100);
+
+    prev = NULL;
+    for (i = 0; i < 100; i++){
+	e = (employee *) ul_ref_index_data(ul, i);
+	assert(e->id == i + 1);
+	assert(prev == NULL || prev->id < e->id);
+	prev = e;
+    }
+
+    key_access_calls = 0;
+    assert(ul_search_by_key(ul, (void *) 42) != NULL);
+    assert(ul_rank(ul, (void *) 42) == 41);
+    assert(!ul_has_key(ul, (void *) 1000));
+    assert(key_access_calls == 0);
+
+    /* Replaced data gets its key cached */
+    e = (employee *) ul_search_by_key(ul, (void *) 1);
+    e->id = 1000;
+    assert(ul_replace_by_key(ul, (void *) 1, (void *) e) == e);
+    assert(ul_search_by_key(ul, (void *) 1000) == e);
+    assert(ul_search_by_key(ul, (void *) 1) == NULL);
+
+    ul_destroy(ul);
+}
+
+static void
+test_split_merge_sort(void){
+    unrolled_list *ul, *first, *merged;
+    ul_attr attr = { .block_capacity = 5 };
+    uintptr_t i, ref[60];
+
+    ul = ul_init_with_attr(NULL, uintptr_key_match, NULL, NULL, &attr);
+    for (i = 0; i < 60; i++)
+	ul_tail_insert(ul, (void *) ((i * 7) % 30 + 1));
+
+    /* Stable sort with duplicated keys */
+    ul_sort(ul);
+    for (i = 0; i < 60; i++)
+	ref[i] = i / 2 + 1;
+    check_elements(ul, ref, 60);
+
+    /* Out of range splits return the list itself */
+    assert(ul_split(ul, 0) == ul);
+    assert(ul_split(ul, 61) == ul);
+
+    /* Split inside a block */
+    first = ul_split(ul, 23);
+    check_elements(first, ref, 23);
+    check_elements(ul, &ref[23], 37);
+
+    merged = ul_merge(first, ul);
+    check_elements(merged, ref, 60);
+    assert(ul_is_empty(first) && ul_is_empty(ul));
+
+    ul_destroy(first);
+    ul_destroy(ul);
+    ul_destroy(merged);
+}
+
+/*
+ * Random operations on lists with integer keys, compared with
+ * the same operations on lists calling key_compare_cb
+ */
+static void
+check_int_keys(ul_int_keys int_keys, bool use_key_access,
+	       unsigned int block_capacity){
+    unrolled_list *ul, *ref;
+    ul_attr attr = { .block_capacity = block_capacity,
+		     .int_keys = int_keys },
+	ref_attr = { .block_capacity = block_capacity };
+    employee employees[1000];
+    void *data, *key;
+    uintptr_t id;
+    int i, op;
+
+    ul = ul_init_with_attr(use_key_access ? employee_key_access : NULL,
+			   NULL, NULL, NULL, &attr);
+    ref = ul_init_with_attr(use_key_access ? employee_key_access : NULL,
+			    int_keys == UL_INT_KEYS_SIGNED ?
+			    intptr_key_match : uintptr_key_match,
+			    NULL, NULL, &ref_attr);
+    assert(ul->cache_keys == use_key_access);
+
+    srand(block_capacity);
+    for (i = 0; i < 1000; i++){
+	/* Keys on both sides of zero and of the sign bit */
+	id = (uintptr_t) (rand() % 200 - 100);
+	if (rand() % 2)
+	    id += (uintptr_t) 1 << (sizeof(uintptr_t) * 8 - 1);
+	if (id == 0)
+	    id = 1;
+	employees[i].id = id;
+	data = use_key_access ? (void *) &employees[i] : (void *) id;
+	key = (void *) id;
+
+	/* Out of order insertions mixed with ascending ones */
+	op = rand() % 5;
+	if (op <= 1){
+	    assert(ul_asc_insert(ul, data) == ul_asc_insert(ref, data));
+	}else if (op == 4){
+	    ul_insert(ul, data);
+	    ul_insert(ref, data);
+	}else if (op == 2){
+	    assert(ul_remove_by_key(ul, key) == ul_remove_by_key(ref, key));
+	}else{
+	    assert(ul_search_by_key(ul, key) == ul_search_by_key(ref, key));
+	    assert(ul_has_key(ul, key) == ul_has_key(ref, key));
+	    assert(ul_rank(ul, key) == ul_rank(ref, key));
+	}
+	assert(ul_get_length(ul) == ul_get_length(ref));
+    }
+
+    for (i = 0; i < ul_get_length(ref); i++)
+	assert(ul_ref_index_data(ul, i) == ul_ref_index_data(ref, i));
+
+    ul_destroy(ul);
+    ul_destroy(ref);
+}
+
+static void
+test_int_keys(void){
+    unsigned int capacities[] = { 1, 2, 3, 7, 16, 64 }, c;
+
+    for (c = 0; c < sizeof(capacities) / sizeof(capacities[0]); c++){
+	check_int_keys(UL_INT_KEYS_SIGNED, false, capacities[c]);
+	check_int_keys(UL_INT_KEYS_SIGNED, true, capacities[c]);
+	check_int_keys(UL_INT_KEYS_UNSIGNED, false, capacities[c]);
+	check_int_keys(UL_INT_KEYS_UNSIGNED, true, capacities[c]);
+    }
+}
+
+static void
+run_bundled_tests(void){
+    printf("<test basic operations>\n");
+    test_basic_operations();
+
+    printf("<test positional operations>\n");
+    test_positional_operations();
+
+    printf("<test small blocks>\n");
+    test_small_blocks();
+
+    printf("<test key cache>\n");
+    test_key_cache();
+
+    printf("<test split, merge and sort>\n");
+    test_split_merge_sort();
+
+    printf("<test integer keys>\n");
+    test_int_keys();
+}
+
+int
+main(void){
+
+    run_bundled_tests();
+
+    printf("All tests are done gracefully\n");
+
+    return 0;
+}
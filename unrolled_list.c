@@ -0,0 +1,977 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unrolled_list.h"
+
+/*
+ * The SIMD scanners need 64-bit keys and the target attribute
+ * of GCC or Clang. Define UL_NO_SIMD to use the scalar ones only.
+ */
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(UL_NO_SIMD)
+#define UL_SIMD
+#include <immintrin.h>
+#endif
+
+/* Cached keys of the block, stored after the data slots */
+#define UL_KEYS(ul, b) ((b)->data + (ul)->block_capacity)
+
+/* Array of the keys of the block, for integer keys */
+#define UL_KEY_ARRAY(ul, b) ((ul)->cache_keys ? UL_KEYS(ul, b) : (b)->data)
+
+/* Integer key comparison with the sign bit flipped by 'bias' */
+#define UL_BIASED(key, bias) ((intptr_t) ((uintptr_t) (key) ^ (bias)))
+
+static ul_block *
+ul_gen_block(unrolled_list *ul){
+    ul_block *b;
+    size_t slots = ul->cache_keys ?
+	2 * ul->block_capacity : ul->block_capacity;
+
+    if ((b = (ul_block *) malloc(sizeof(ul_block) +
+				 slots * sizeof(void *))) == NULL){
+	perror("malloc");
+	exit(-1);
+    }
+
+    b->next = b->prev = NULL;
+    b->count = 0;
+
+    return b;
+}
+
+/* Connect 'b' just after 'prev'. When 'prev' is NULL, 'b' becomes the head */
+static void
+ul_link_block(unrolled_list *ul, ul_block *prev, ul_block *b){
+    b->prev = prev;
+    b->next = prev == NULL ? ul->head : prev->next;
+
+    if (prev == NULL)
+	ul->head = b;
+    else
+	prev->next = b;
+
+    if (b->next == NULL)
+	ul->tail = b;
+    else
+	b->next->prev = b;
+}
+
+static void
+ul_unlink_block(unrolled_list *ul, ul_block *b){
+    if (b->prev == NULL)
+	ul->head = b->next;
+    else
+	b->prev->next = b->next;
+
+    if (b->next == NULL)
+	ul->tail = b->prev;
+    else
+	b->next->prev = b->prev;
+
+    if (ul->finger == b)
+	ul->finger = NULL;
+}
+
+static void *
+ul_data_key(unrolled_list *ul, void *data){
+    return ul->key_access_cb == NULL ? data : ul->key_access_cb(data);
+}
+
+/* Return the key of the i-th element in 'b' */
+static void *
+ul_key_at(unrolled_list *ul, ul_block *b, unsigned int i){
+    if (ul->cache_keys)
+	return UL_KEYS(ul, b)[i];
+
+    return ul_data_key(ul, b->data[i]);
+}
+
+static int
+ul_compare_at(unrolled_list *ul, ul_block *b, unsigned int i, void *key){
+    return ul->key_compare_cb(ul_key_at(ul, b, i), key,
+			      ul->keys_compare_metadata);
+}
+
+static int
+ul_compare_signed(void *key1, void *key2, void *metadata){
+    intptr_t k1 = (intptr_t) key1, k2 = (intptr_t) key2;
+
+    return k1 < k2 ? -1 : k1 > k2;
+}
+
+static int
+ul_compare_unsigned(void *key1, void *key2, void *metadata){
+    uintptr_t k1 = (uintptr_t) key1, k2 = (uintptr_t) key2;
+
+    return k1 < k2 ? -1 : k1 > k2;
+}
+
+static unsigned int
+ul_scan_equal_scalar(void **keys, unsigned int count, void *key){
+    unsigned int i;
+
+    for (i = 0; i < count; i++)
+	if (keys[i] == key)
+	    break;
+
+    return i;
+}
+
+static unsigned int
+ul_scan_greater_scalar(void **keys, unsigned int count, void *key,
+		       uintptr_t bias){
+    intptr_t k = UL_BIASED(key, bias);
+    unsigned int i;
+
+    for (i = 0; i < count; i++)
+	if (UL_BIASED(keys[i], bias) > k)
+	    break;
+
+    return i;
+}
+
+#ifdef UL_SIMD
+/*
+ * Compare four keys per instruction with AVX2, and two with
+ * SSE4.2. The rest of the block goes to the scalar scanners.
+ */
+__attribute__((target("avx2")))
+static unsigned int
+ul_scan_equal_avx2(void **keys, unsigned int count, void *key){
+    __m256i k = _mm256_set1_epi64x((long long) (intptr_t) key);
+    unsigned int i, mask;
+
+    for (i = 0; i + 4 <= count; i += 4){
+	mask = _mm256_movemask_pd(_mm256_castsi256_pd(
+	    _mm256_cmpeq_epi64(_mm256_loadu_si256((__m256i *) &keys[i]), k)));
+	if (mask != 0)
+	    return i + __builtin_ctz(mask);
+    }
+
+    return i + ul_scan_equal_scalar(&keys[i], count - i, key);
+}
+
+__attribute__((target("avx2")))
+static unsigned int
+ul_scan_greater_avx2(void **keys, unsigned int count, void *key,
+		     uintptr_t bias){
+    __m256i b = _mm256_set1_epi64x((long long) bias),
+	k = _mm256_set1_epi64x((long long) UL_BIASED(key, bias));
+    unsigned int i, mask;
+
+    for (i = 0; i + 4 <= count; i += 4){
+	mask = _mm256_movemask_pd(_mm256_castsi256_pd(
+	    _mm256_cmpgt_epi64(_mm256_xor_si256(
+		_mm256_loadu_si256((__m256i *) &keys[i]), b), k)));
+	if (mask != 0)
+	    return i + __builtin_ctz(mask);
+    }
+
+    return i + ul_scan_greater_scalar(&keys[i], count - i, key, bias);
+}
+
+__attribute__((target("sse4.2")))
+static unsigned int
+ul_scan_equal_sse42(void **keys, unsigned int count, void *key){
+    __m128i k = _mm_set1_epi64x((long long) (intptr_t) key);
+    unsigned int i, mask;
+
+    for (i = 0; i + 2 <= count; i += 2){
+	mask = _mm_movemask_pd(_mm_castsi128_pd(
+	    _mm_cmpeq_epi64(_mm_loadu_si128((__m128i *) &keys[i]), k)));
+	if (mask != 0)
+	    return i + __builtin_ctz(mask);
+    }
+
+    return i + ul_scan_equal_scalar(&keys[i], count - i, key);
+}
+
+__attribute__((target("sse4.2")))
+static unsigned int
+ul_scan_greater_sse42(void **keys, unsigned int count, void *key,
+		      uintptr_t bias){
+    __m128i b = _mm_set1_epi64x((long long) bias),
+	k = _mm_set1_epi64x((long long) UL_BIASED(key, bias));
+    unsigned int i, mask;
+
+    for (i = 0; i + 2 <= count; i += 2){
+	mask = _mm_movemask_pd(_mm_castsi128_pd(
+	    _mm_cmpgt_epi64(_mm_xor_si128(
+		_mm_loadu_si128((__m128i *) &keys[i]), b), k)));
+	if (mask != 0)
+	    return i + __builtin_ctz(mask);
+    }
+
+    return i + ul_scan_greater_scalar(&keys[i], count - i, key, bias);
+}
+#endif
+
+/* Choose the scanners of integer keys for the running CPU */
+static void
+ul_select_scanners(unrolled_list *ul){
+    ul->scan_equal = ul_scan_equal_scalar;
+    ul->scan_greater = ul_scan_greater_scalar;
+
+#ifdef UL_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")){
+	ul->scan_equal = ul_scan_equal_avx2;
+	ul->scan_greater = ul_scan_greater_avx2;
+    }else if (__builtin_cpu_supports("sse4.2")){
+	ul->scan_equal = ul_scan_equal_sse42;
+	ul->scan_greater = ul_scan_greater_sse42;
+    }
+#endif
+}
+
+/* Move 'count' elements from src[si] to dst[di], together with their keys */
+static void
+ul_move_elems(unrolled_list *ul, ul_block *dst, unsigned int di,
+	      ul_block *src, unsigned int si, unsigned int count){
+    memmove(&dst->data[di], &src->data[si], count * sizeof(void *));
+    if (ul->cache_keys)
+	memmove(&UL_KEYS(ul, dst)[di], &UL_KEYS(ul, src)[si],
+		count * sizeof(void *));
+}
+
+static void
+ul_store(unrolled_list *ul, ul_block *b, unsigned int i,
+	 void *data, void *key){
+    b->data[i] = data;
+    if (ul->cache_keys)
+	UL_KEYS(ul, b)[i] = key;
+}
+
+/*
+ * Insert 'data' whose key is 'key' at the offset 'i' of 'b'.
+ * 'index' is the position of the new element in the list.
+ * When 'b' is NULL, the list must be empty.
+ */
+static void
+ul_insert_at(unrolled_list *ul, ul_block *b, unsigned int i,
+	     void *data, void *key, uintptr_t index){
+    ul_block *nb;
+    unsigned int half;
+
+    if (b == NULL){
+	assert(ul->head == NULL);
+	b = ul_gen_block(ul);
+	ul_link_block(ul, NULL, b);
+    }else if (b->count == ul->block_capacity){
+	/* Split the full block into halves */
+	nb = ul_gen_block(ul);
+	half = b->count / 2;
+	ul_move_elems(ul, nb, 0, b, half, b->count - half);
+	nb->count = b->count - half;
+	b->count = half;
+	ul_link_block(ul, b, nb);
+
+	if (i > half){
+	    b = nb;
+	    i -= half;
+	}
+    }
+
+    /* Shift the following elements */
+    ul_move_elems(ul, b, i + 1, b, i, b->count - i);
+    ul_store(ul, b, i, data, key);
+    b->count++;
+    ul->elem_count++;
+
+    /* Blocks before the finger shift it */
+    if (ul->finger != NULL && ul->finger != b && index <= ul->finger_index)
+	ul->finger_index++;
+}
+
+/*
+ * Remove the element at the offset 'i' of 'b', whose position
+ * in the list is 'index', and return its data.
+ */
+static void *
+ul_remove_at(unrolled_list *ul, ul_block *b, unsigned int i,
+	     uintptr_t index){
+    ul_block *next;
+    void *data = b->data[i];
+
+    ul_move_elems(ul, b, i, b, i + 1, b->count - i - 1);
+    b->count--;
+    ul->elem_count--;
+
+    if (ul->finger != NULL && ul->finger != b && index < ul->finger_index)
+	ul->finger_index--;
+
+    if (b->count == 0){
+	ul_unlink_block(ul, b);
+	free(b);
+    }else if (b->count < ul->block_capacity / 2 &&
+	      (next = b->next) != NULL &&
+	      b->count + next->count <= ul->block_capacity){
+	/* Keep the blocks at least half full by merging the next one */
+	ul_move_elems(ul, b, b->count, next, 0, next->count);
+	b->count += next->count;
+	ul_unlink_block(ul, next);
+	free(next);
+    }
+
+    return data;
+}
+
+/*
+ * Return the block which holds the element at 'index' and set
+ * 'start' to the position of the first element of the block.
+ */
+static ul_block *
+ul_block_at(unrolled_list *ul, uintptr_t index, uintptr_t *start){
+    ul_block *b = ul->head;
+    uintptr_t pos = 0;
+
+    assert(index < ul->elem_count);
+
+    if (index >= ul->elem_count - ul->tail->count){
+	b = ul->tail;
+	pos = ul->elem_count - b->count;
+    }else{
+	/* Resume from the last resolved block */
+	if (ul->finger != NULL && ul->finger_index <= index){
+	    b = ul->finger;
+	    pos = ul->finger_index;
+	}
+	while(index >= pos + b->count){
+	    pos += b->count;
+	    b = b->next;
+	}
+    }
+
+    ul->finger = b;
+    ul->finger_index = pos;
+    *start = pos;
+
+    return b;
+}
+
+/*
+ * Find the first element whose key equals to 'key'. Set 'b',
+ * 'i' and 'index' to where it is. Return false if not found.
+ */
+static bool
+ul_find_key(unrolled_list *ul, void *key, ul_block **b,
+	    unsigned int *i, uintptr_t *index){
+    ul_block *curr;
+    uintptr_t pos = 0;
+    unsigned int j;
+
+    for (curr = ul->head; curr != NULL; curr = curr->next){
+	if (ul->int_keys != UL_INT_KEYS_NONE){
+	    j = ul->scan_equal(UL_KEY_ARRAY(ul, curr), curr->count, key);
+	    if (j < curr->count){
+		*b = curr;
+		*i = j;
+		*index = pos + j;
+		return true;
+	    }
+	    pos += curr->count;
+	    continue;
+	}
+	for (j = 0; j < curr->count; j++){
+	    if (ul_compare_at(ul, curr, j, key) == 0){
+		*b = curr;
+		*i = j;
+		*index = pos + j;
+		return true;
+	    }
+	}
+	pos += curr->count;
+    }
+
+    return false;
+}
+
+unrolled_list *
+ul_init(void *(*key_access_cb)(void *data),
+	int (*key_compare_cb)(void *key1,
+			      void *key2,
+			      void *metadata),
+	void (*free_cb)(void *data),
+	void *keys_compare_metadata){
+    return ul_init_with_attr(key_access_cb, key_compare_cb,
+			     free_cb, keys_compare_metadata, NULL);
+}
+
+unrolled_list *
+ul_init_with_attr(void *(*key_access_cb)(void *data),
+		  int (*key_compare_cb)(void *key1,
+					void *key2,
+					void *key_compare_metadata),
+		  void (*free_cb)(void *data),
+		  void *keys_compare_metadata,
+		  const ul_attr *attr){
+    unrolled_list *new_ul;
+
+    if ((new_ul = (unrolled_list *) malloc(sizeof(unrolled_list))) == NULL){
+	perror("malloc");
+	exit(-1);
+    }
+
+    new_ul->elem_count = 0;
+    new_ul->head = new_ul->tail = NULL;
+    new_ul->finger = NULL;
+    new_ul->finger_index = 0;
+
+    new_ul->key_access_cb = key_access_cb;
+    new_ul->key_compare_cb = key_compare_cb;
+    new_ul->free_cb = free_cb;
+    new_ul->keys_compare_metadata = keys_compare_metadata;
+
+    new_ul->current_block = NULL;
+    new_ul->current_index = 0;
+    new_ul->iter_in_progress = false;
+
+    /* Optional settings */
+    new_ul->block_capacity = UL_DEFAULT_BLOCK_CAPACITY;
+    new_ul->cache_keys = false;
+    new_ul->int_keys = UL_INT_KEYS_NONE;
+    if (attr != NULL){
+	if (attr->block_capacity > 0)
+	    new_ul->block_capacity =
+		attr->block_capacity < UL_MIN_BLOCK_CAPACITY ?
+		UL_MIN_BLOCK_CAPACITY : attr->block_capacity;
+	new_ul->int_keys = attr->int_keys;
+	/* Without key_access_cb, the data is the key */
+	new_ul->cache_keys = (attr->cache_keys ||
+			      attr->int_keys != UL_INT_KEYS_NONE) &&
+	    key_access_cb != NULL;
+    }
+
+    /* Integer keys are compared without key_compare_cb */
+    new_ul->key_bias = 0;
+    if (new_ul->int_keys == UL_INT_KEYS_SIGNED){
+	new_ul->key_compare_cb = ul_compare_signed;
+    }else if (new_ul->int_keys == UL_INT_KEYS_UNSIGNED){
+	new_ul->key_compare_cb = ul_compare_unsigned;
+	/* Flip the sign bit to compare them as signed integers */
+	new_ul->key_bias = (uintptr_t) 1 << (sizeof(uintptr_t) * 8 - 1);
+    }
+    ul_select_scanners(new_ul);
+
+    return new_ul;
+}
+
+/* Create an empty list with the same callbacks and settings as 'ul' */
+static unrolled_list *
+ul_init_like(unrolled_list *ul){
+    ul_attr attr = { .block_capacity = ul->block_capacity,
+		     .cache_keys = ul->cache_keys,
+		     .int_keys = ul->int_keys };
+
+    return ul_init_with_attr(ul->key_access_cb, ul->key_compare_cb,
+			     ul->free_cb, ul->keys_compare_metadata,
+			     &attr);
+}
+
+bool
+ul_is_empty(unrolled_list *ul){
+    assert(ul != NULL);
+
+    return ul->elem_count == 0;
+}
+
+int
+ul_get_length(unrolled_list *ul){
+    return ul->elem_count;
+}
+
+bool
+ul_has_key(unrolled_list *ul, void *key){
+    ul_block *b;
+    unsigned int i;
+    uintptr_t index;
+
+    if (ul == NULL || ul->head == NULL)
+	return false;
+
+    return ul_find_key(ul, key, &b, &i, &index);
+}
+
+void
+ul_insert(unrolled_list *ul, void *data){
+    if (!ul)
+	return;
+
+    ul_insert_at(ul, ul->head, 0, data, ul->cache_keys ?
+		 ul_data_key(ul, data) : NULL, 0);
+}
+
+void
+ul_tail_insert(unrolled_list *ul, void *data){
+    if (!ul)
+	return;
+
+    ul_insert_at(ul, ul->tail, ul->tail == NULL ? 0 : ul->tail->count,
+		 data, ul->cache_keys ? ul_data_key(ul, data) : NULL,
+		 ul->elem_count);
+}
+
+/*
+ * Insert an entry in ascending order and return the index
+ * of inserted position, like ll_asc_insert().
+ */
+int
+ul_asc_insert(unrolled_list *ul, void *new_data){
+    ul_block *b, *last = NULL;
+    void *key;
+    uintptr_t pos = 0;
+    unsigned int i = 0;
+
+    if (!ul)
+	return -1;
+
+    key = ul_data_key(ul, new_data);
+
+    /* Find the first element whose key is larger than the new one */
+    for (b = ul->head; b != NULL; b = b->next){
+	if (ul->int_keys != UL_INT_KEYS_NONE){
+	    i = ul->scan_greater(UL_KEY_ARRAY(ul, b), b->count, key,
+				 ul->key_bias);
+	}else{
+	    for (i = 0; i < b->count; i++){
+		if (ul->key_compare_cb(ul_key_at(ul, b, i), key,
+				       ul->keys_compare_metadata) > 0)
+		    break;
+	    }
+	}
+	pos += i;
+	if (i < b->count)
+	    break;
+	last = b;
+    }
+
+    /* Otherwise, insert at the end */
+    if (b == NULL){
+	b = last;
+	i = b == NULL ? 0 : b->count;
+    }
+
+    ul_insert_at(ul, b, i, new_data, key, pos);
+
+    return pos;
+}
+
+void
+ul_index_insert(unrolled_list *ul, void *new_data, int index){
+    ul_block *b;
+    uintptr_t start;
+
+    if (!ul || index < 0)
+	return;
+
+    if (ul_get_length(ul) < index)
+	return;
+
+    if (index == ul_get_length(ul)){
+	ul_tail_insert(ul, new_data);
+    }else{
+	b = ul_block_at(ul, index, &start);
+	ul_insert_at(ul, b, index - start, new_data,
+		     ul->cache_keys ? ul_data_key(ul, new_data) : NULL,
+		     index);
+    }
+}
+
+/*
+ * Remove the element at 'index'. As ll_index_remove() does,
+ * free_cb is called for the data unless it is the first or
+ * the last element.
+ */
+void *
+ul_index_remove(unrolled_list *ul, int index){
+    ul_block *b;
+    uintptr_t start;
+    void *data;
+
+    if (ul == NULL || ul->head == NULL ||
+	index < 0 || ul_get_length(ul) - 1 < index)
+	return NULL;
+
+    if (index == 0)
+	return ul_remove_first_data(ul);
+
+    if (index == ul_get_length(ul) - 1)
+	return ul_tail_remove(ul);
+
+    b = ul_block_at(ul, index, &start);
+    data = ul_remove_at(ul, b, index - start, index);
+
+    if (ul->free_cb)
+	ul->free_cb(data);
+
+    return data;
+}
+
+void *
+ul_remove_first_data(unrolled_list *ul){
+    if (ul == NULL || ul->head == NULL)
+	return NULL;
+
+    return ul_remove_at(ul, ul->head, 0, 0);
+}
+
+void *
+ul_ref_index_data(unrolled_list *ul, int index){
+    ul_block *b;
+    uintptr_t start;
+
+    if (ul == NULL || index < 0 || ul_get_length(ul) <= index)
+	return NULL;
+
+    b = ul_block_at(ul, index, &start);
+
+    return b->data[index - start];
+}
+
+/*
+ * Return the number of elements whose keys are smaller than
+ * 'key', like ll_rank(). Return -1 on failure.
+ */
+int
+ul_rank(unrolled_list *ul, void *key){
+    ul_block *b;
+    unsigned int i;
+    int rank = 0;
+
+    if (ul == NULL || ul->key_compare_cb == NULL)
+	return -1;
+
+    for (b = ul->head; b != NULL; b = b->next)
+	for (i = 0; i < b->count; i++)
+	    if (ul_compare_at(ul, b, i, key) < 0)
+		rank++;
+
+    return rank;
+}
+
+/* Don't remove the hit element from the list */
+void *
+ul_search_by_key(unrolled_list *ul, void *key){
+    ul_block *b;
+    unsigned int i;
+    uintptr_t index;
+
+    if (!ul || !ul->head || !key || !ul->key_compare_cb)
+	return NULL;
+
+    if (!ul_find_key(ul, key, &b, &i, &index))
+	return NULL;
+
+    return b->data[i];
+}
+
+void *
+ul_remove_by_key(unrolled_list *ul, void *key){
+    ul_block *b;
+    unsigned int i;
+    uintptr_t index;
+
+    if (!ul || !key || !ul->head || !ul->key_compare_cb)
+	return NULL;
+
+    if (!ul_find_key(ul, key, &b, &i, &index))
+	return NULL;
+
+    return ul_remove_at(ul, b, i, index);
+}
+
+void *
+ul_replace_by_key(unrolled_list *ul, void *old_key, void *new_data){
+    ul_block *b;
+    unsigned int i;
+    uintptr_t index;
+    void *tmp;
+
+    if (ul == NULL || ul->head == NULL)
+	return NULL;
+
+    if (!ul_find_key(ul, old_key, &b, &i, &index))
+	return NULL;
+
+    tmp = b->data[i];
+    ul_store(ul, b, i, new_data, ul->cache_keys ?
+	     ul_data_key(ul, new_data) : NULL);
+
+    return tmp;
+}
+
+void *
+ul_tail_remove(unrolled_list *ul){
+    if (ul == NULL || ul->head == NULL)
+	return NULL;
+
+    return ul_remove_at(ul, ul->tail, ul->tail->count - 1,
+			ul->elem_count - 1);
+}
+
+/* Release all blocks without touching the data */
+static void
+ul_release_blocks(unrolled_list *ul){
+    ul_block *b, *next;
+
+    for (b = ul->head; b != NULL; b = next){
+	next = b->next;
+	free(b);
+    }
+
+    ul->head = ul->tail = NULL;
+    ul->elem_count = 0;
+    ul->finger = NULL;
+}
+
+void
+ul_remove_all(unrolled_list *ul){
+    ul_block *b;
+    unsigned int i;
+
+    if (ul == NULL)
+	return;
+
+    if (ul->free_cb){
+	for (b = ul->head; b != NULL; b = b->next)
+	    for (i = 0; i < b->count; i++)
+		if (b->data[i])
+		    ul->free_cb(b->data[i]);
+    }
+
+    ul_release_blocks(ul);
+}
+
+/*
+ * Move the first 'no_elems' elements to a new list. Return
+ * 'ul' itself when the number is out of range.
+ */
+unrolled_list *
+ul_split(unrolled_list *ul, int no_elems){
+    unrolled_list *new_list;
+    ul_block *b, *nb;
+    uintptr_t rest = no_elems;
+
+    if (ul_get_length(ul) < no_elems){
+	return ul;
+    }else if (no_elems <= 0){
+	return ul;
+    }
+
+    new_list = ul_init_like(ul);
+
+    /* Relink whole blocks */
+    while(ul->head != NULL && ul->head->count <= rest){
+	b = ul->head;
+	rest -= b->count;
+	ul_unlink_block(ul, b);
+	ul_link_block(new_list, new_list->tail, b);
+	ul->elem_count -= b->count;
+	new_list->elem_count += b->count;
+    }
+
+    /* Copy the rest out of the block across the boundary */
+    if (rest > 0){
+	b = ul->head;
+	nb = ul_gen_block(new_list);
+	ul_move_elems(ul, nb, 0, b, 0, rest);
+	ul_move_elems(ul, b, 0, b, rest, b->count - rest);
+	nb->count = rest;
+	b->count -= rest;
+	ul_link_block(new_list, new_list->tail, nb);
+	ul->elem_count -= rest;
+	new_list->elem_count += rest;
+    }
+
+    ul->finger = NULL;
+
+    return new_list;
+}
+
+/* Append 'data' with its 'key' to the end of 'ul' */
+static void
+ul_append(unrolled_list *ul, void *data, void *key){
+    ul_block *b = ul->tail;
+
+    if (b == NULL || b->count == ul->block_capacity){
+	b = ul_gen_block(ul);
+	ul_link_block(ul, ul->tail, b);
+    }
+
+    ul_store(ul, b, b->count, data, key);
+    b->count++;
+    ul->elem_count++;
+}
+
+/*
+ * Merge two lists in ascending order into a new list, like
+ * ll_merge(). Both input lists become empty.
+ */
+unrolled_list *
+ul_merge(unrolled_list *ul1, unrolled_list *ul2){
+    unrolled_list *result;
+    ul_block *b1, *b2;
+    unsigned int i1 = 0, i2 = 0;
+    void *k1, *k2;
+
+    /* Are the two lists joinable ? */
+    assert(ul1->key_access_cb == ul2->key_access_cb);
+    assert(ul1->key_compare_cb == ul2->key_compare_cb);
+    assert(ul1->free_cb == ul2->free_cb);
+    assert(ul1->keys_compare_metadata == ul2->keys_compare_metadata);
+    assert(ul1->block_capacity == ul2->block_capacity);
+    assert(ul1->cache_keys == ul2->cache_keys);
+    assert(ul1->int_keys == ul2->int_keys);
+
+    result = ul_init_like(ul1);
+
+    b1 = ul1->head;
+    b2 = ul2->head;
+    while(b1 != NULL && b2 != NULL){
+	k1 = ul_key_at(ul1, b1, i1);
+	k2 = ul_key_at(ul2, b2, i2);
+
+	if (result->key_compare_cb(k1, k2,
+				   result->keys_compare_metadata) <= 0){
+	    ul_append(result, b1->data[i1], k1);
+	    if (++i1 == b1->count){
+		b1 = b1->next;
+		i1 = 0;
+	    }
+	}else{
+	    ul_append(result, b2->data[i2], k2);
+	    if (++i2 == b2->count){
+		b2 = b2->next;
+		i2 = 0;
+	    }
+	}
+    }
+
+    /* Move the rest of the remaining list */
+    for (; b1 != NULL; b1 = b1->next, i1 = 0)
+	for (; i1 < b1->count; i1++)
+	    ul_append(result, b1->data[i1], ul_key_at(ul1, b1, i1));
+    for (; b2 != NULL; b2 = b2->next, i2 = 0)
+	for (; i2 < b2->count; i2++)
+	    ul_append(result, b2->data[i2], ul_key_at(ul2, b2, i2));
+
+    ul_release_blocks(ul1);
+    ul_release_blocks(ul2);
+
+    return result;
+}
+
+/*
+ * Sort the list in ascending order of keys. Equal keys keep
+ * their order. The elements are sorted in a flat array with
+ * a bottom-up merge sort and written back to the same blocks.
+ */
+void
+ul_sort(unrolled_list *ul){
+    ul_block *b;
+    uintptr_t n, i, j, k, lo, mid, hi, width;
+    void **buf, **data, **keys, **tmp_data, **tmp_keys, **swap;
+    unsigned int l;
+
+    if (ul == NULL || ul->key_compare_cb == NULL || ul->elem_count < 2)
+	return;
+
+    n = ul->elem_count;
+    if ((buf = (void **) malloc(4 * n * sizeof(void *))) == NULL){
+	perror("malloc");
+	exit(-1);
+    }
+    data = buf;
+    keys = buf + n;
+    tmp_data = buf + 2 * n;
+    tmp_keys = buf + 3 * n;
+
+    /* Extract every key only once */
+    for (b = ul->head, i = 0; b != NULL; b = b->next){
+	for (l = 0; l < b->count; l++, i++){
+	    data[i] = b->data[l];
+	    keys[i] = ul_key_at(ul, b, l);
+	}
+    }
+
+    for (width = 1; width < n; width *= 2){
+	for (lo = 0; lo < n; lo += 2 * width){
+	    mid = lo + width < n ? lo + width : n;
+	    hi = mid + width < n ? mid + width : n;
+
+	    for (i = lo, j = mid, k = lo; k < hi; k++){
+		if (j >= hi ||
+		    (i < mid && ul->key_compare_cb(keys[i], keys[j],
+						   ul->keys_compare_metadata) <= 0)){
+		    tmp_data[k] = data[i];
+		    tmp_keys[k] = keys[i++];
+		}else{
+		    tmp_data[k] = data[j];
+		    tmp_keys[k] = keys[j++];
+		}
+	    }
+	}
+	swap = data; data = tmp_data; tmp_data = swap;
+	swap = keys; keys = tmp_keys; tmp_keys = swap;
+    }
+
+    for (b = ul->head, i = 0; b != NULL; b = b->next)
+	for (l = 0; l < b->count; l++, i++)
+	    ul_store(ul, b, l, data[i], keys[i]);
+
+    free(buf);
+}
+
+void
+ul_begin_iter(unrolled_list *ul){
+    assert(ul->iter_in_progress == false);
+    assert(ul->current_block == NULL);
+
+    ul->iter_in_progress = true;
+    /* Set the element which will be referenced next */
+    ul->current_block = ul->head;
+    ul->current_index = 0;
+}
+
+void *
+ul_get_iter_data(unrolled_list *ul){
+    ul_block *b;
+    void *data;
+
+    assert(ul->iter_in_progress == true);
+
+    if ((b = ul->current_block) == NULL)
+	return NULL;
+
+    data = b->data[ul->current_index];
+
+    /* Shift to the next element for the next call */
+    if (++ul->current_index == b->count){
+	ul->current_block = b->next;
+	ul->current_index = 0;
+    }
+
+    return data;
+}
+
+void
+ul_end_iter(unrolled_list *ul){
+    assert(ul->iter_in_progress == true);
+
+    ul->iter_in_progress = false;
+    ul->current_block = NULL;
+    ul->current_index = 0;
+}
+
+void
+ul_destroy(unrolled_list *ul){
+    if (ul == NULL)
+	return;
+
+    ul_remove_all(ul);
+
+    assert(ul_get_length(ul) == 0);
+
+    free(ul);
+}
@@ -0,0 +1,178 @@
+#ifndef __UNROLLED_LIST__
+#define __UNROLLED_LIST__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Unrolled linked list.
+ *
+ * Same collection and same semantics as linked_list, but each
+ * block stores up to 'block_capacity' data pointers (and their
+ * keys, optionally) in one contiguous array. A scan then misses
+ * the cache about once per block rather than once per element.
+ *
+ * The functions correspond to the ll_ functions of the same
+ * names in linked_list.h.
+ */
+
+/*
+ * One block of the list.
+ *
+ * 'data' holds 'count' elements from the beginning. When the
+ * list caches keys, their keys are stored in the same order
+ * just after the 'block_capacity' data slots.
+ */
+typedef struct ul_block {
+    struct ul_block *next;
+    struct ul_block *prev;
+    unsigned int count;
+    void *data[];
+} ul_block;
+
+/*
+ * Kinds of integer keys. The key returned by key_access_cb, or
+ * the data itself without key_access_cb, is an integer cast to
+ * a pointer. Sign-extend narrower signed integers into intptr_t.
+ */
+typedef enum ul_int_keys {
+    UL_INT_KEYS_NONE = 0,
+    UL_INT_KEYS_SIGNED,
+    UL_INT_KEYS_UNSIGNED
+} ul_int_keys;
+
+/*
+ * Optional settings of unrolled_list, passed to ul_init_with_attr().
+ *
+ * Zero-initialized members keep the default behavior of ul_init().
+ */
+typedef struct ul_attr {
+
+    /*
+     * Maximum number of elements in one block. The default is
+     * UL_DEFAULT_BLOCK_CAPACITY. Smaller values than
+     * UL_MIN_BLOCK_CAPACITY are raised to it, since a full block
+     * is split into two non-empty halves.
+     */
+    unsigned int block_capacity;
+
+    /*
+     * Store the key returned by key_access_cb next to the data
+     * at insertion, so that key scans read the keys in sequence
+     * without calling key_access_cb. ul_replace_by_key() refreshes
+     * the stored key. Has no effect without key_access_cb.
+     */
+    bool cache_keys;
+
+    /*
+     * Compare the keys as integers instead of calling
+     * key_compare_cb, which may be NULL then. The keys are kept
+     * in one array per block (implying cache_keys with
+     * key_access_cb), and the key scans of ul_search_by_key(),
+     * ul_has_key(), ul_remove_by_key(), ul_replace_by_key() and
+     * ul_asc_insert() compare several keys per SIMD instruction
+     * when the CPU supports AVX2 or SSE4.2.
+     */
+    ul_int_keys int_keys;
+
+} ul_attr;
+
+#define UL_DEFAULT_BLOCK_CAPACITY 16
+#define UL_MIN_BLOCK_CAPACITY 2
+
+typedef struct unrolled_list {
+
+    /* Number of elements, not blocks */
+    uintptr_t elem_count;
+
+    ul_block *head;
+    ul_block *tail;
+
+    /*
+     * The block resolved by the last positional access and the
+     * position of its first element. Positional accesses at or
+     * after it resume from here.
+     */
+    ul_block *finger;
+    uintptr_t finger_index;
+
+    /* Same as the callbacks of linked_list */
+    void *(*key_access_cb)(void *data);
+    int (*key_compare_cb)(void *key1,
+			  void *key2,
+			  void *key_compare_metadata);
+    void (*free_cb)(void *data);
+    void *keys_compare_metadata;
+
+    /* Iteration control */
+    ul_block *current_block;
+    unsigned int current_index;
+    bool iter_in_progress;
+
+    /* Settings given at initialization */
+    unsigned int block_capacity;
+    bool cache_keys;
+    ul_int_keys int_keys;
+
+    /*
+     * Scanners of a key array for integer keys, chosen at
+     * initialization for the CPU. Return the offset of the first
+     * key equal to (or greater than) 'key', or 'count' if none.
+     * scan_greater() compares the keys xor-ed with 'bias' as
+     * signed integers, which is 'key_bias' of the list.
+     */
+    unsigned int (*scan_equal)(void **keys, unsigned int count, void *key);
+    unsigned int (*scan_greater)(void **keys, unsigned int count, void *key,
+				 uintptr_t bias);
+    uintptr_t key_bias;
+
+} unrolled_list;
+
+unrolled_list *ul_init(void *(*key_access_cb)(void *data),
+		       int (*key_compare_cb)(void *key1,
+					     void *key2,
+					     void *metadata),
+		       void (*free_cb)(void *data),
+		       void *key_compare_metadata);
+unrolled_list *ul_init_with_attr(void *(*key_access_cb)(void *data),
+				 int (*key_compare_cb)(void *key1,
+						       void *key2,
+						       void *metadata),
+				 void (*free_cb)(void *data),
+				 void *key_compare_metadata,
+				 const ul_attr *attr);
+
+bool ul_is_empty(unrolled_list *ul);
+bool ul_has_key(unrolled_list *ul, void *key);
+int ul_get_length(unrolled_list *ul);
+
+/* Basic operations (insert, delete, search ... etc) */
+void ul_insert(unrolled_list *ul, void *p);
+void ul_tail_insert(unrolled_list *ul, void *p);
+int ul_asc_insert(unrolled_list *ul, void *p);
+void ul_index_insert(unrolled_list *ul, void *p, int index);
+void *ul_index_remove(unrolled_list *ul, int index);
+void *ul_remove_first_data(unrolled_list *ul);
+void *ul_ref_index_data(unrolled_list *ul, int index);
+int ul_rank(unrolled_list *ul, void *key);
+void *ul_search_by_key(unrolled_list *ul, void *key);
+void *ul_remove_by_key(unrolled_list *ul, void *key);
+void *ul_replace_by_key(unrolled_list *ul, void *old_key,
+			void *new_data);
+void *ul_tail_remove(unrolled_list *ul);
+void ul_remove_all(unrolled_list *ul);
+
+/* Some extra features */
+unrolled_list *ul_split(unrolled_list *ul, int no_elems);
+unrolled_list *ul_merge(unrolled_list *ul1, unrolled_list *ul2);
+void ul_sort(unrolled_list *ul);
+
+/* iteration feature */
+void ul_begin_iter(unrolled_list *ul);
+void *ul_get_iter_data(unrolled_list *ul);
+void ul_end_iter(unrolled_list *ul);
+
+void ul_destroy(unrolled_list *ul);
+
+#endif